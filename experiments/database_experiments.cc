@@ -3,9 +3,11 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <random>
+#include <thread>
 
 #include "../src/constants.hh"
 #include "../src/database.hh"
@@ -371,6 +373,296 @@ void experiment3() {
   lsm_db.Close();
 }
 
+void experiment4() {
+  deleteAllFilesInDirectory("experiments/ssts/read-mode");
+  // Compare Get throughput of O_DIRECT reads through the bufferpool against
+  // reads from memory-mapped SSTs, on the same B-tree SSTs
+  int MB = 1048576;
+  int memtable_size = MB / 16;      // 1MB memtable, in 16 byte entries
+  int bufferpool_capacity = 2560;   // 10MB bufferpool, in pages
+  string dir_path = "experiments/ssts/read-mode";
+  const char *read_modes[] = {DIRECT_IO, MMAP_IO};
+
+  vector<double> get_throughputs[2];
+  int inserted_keys = 0;
+
+  for (int i = 0; i < 7; i++) {
+    // Number of keys in db after puts are complete
+    int num_keys = (int)pow(2, i) * MB / 16;
+
+    Database writer(memtable_size, bufferpool_capacity);
+    writer.Open(dir_path, BSST);
+    cout << "Inserting " << (num_keys - inserted_keys) * 16 / MB << " MB"
+         << endl;
+    for (int key = inserted_keys + 1; key <= num_keys; key++) {
+      writer.Put(key, key);
+    }
+    inserted_keys = num_keys;
+    writer.Close();
+
+    // Pre-generating keys to read
+    const unsigned int seed = 123456789;
+    mt19937 gen(seed);
+    uniform_int_distribution<> distrib(1, num_keys);
+    int num_gets = ceil(0.01 * num_keys);
+    vector<int> get_keys(num_gets);
+    for (int j = 0; j < num_gets; j++) {
+      get_keys[j] = distrib(gen);
+    }
+
+    cout << "Reading database with size " << num_keys * 16 / MB << "MB"
+         << endl;
+    for (int mode = 0; mode < 2; mode++) {
+      Database reader(memtable_size, bufferpool_capacity, 10,
+                      read_modes[mode]);
+      reader.Open(dir_path, BSST);
+
+      auto start = chrono::steady_clock::now();
+      for (int j = 0; j < num_gets; j++) {
+        reader.Get(get_keys[j]);
+      }
+      auto stop = chrono::steady_clock::now();
+      auto duration = chrono::duration<double>(stop - start).count();
+      get_throughputs[mode].push_back(num_gets / duration);
+
+      reader.Close();
+    }
+  }
+
+  cout << "GET Throughput:" << endl;
+  cout << "database size (MB)," << read_modes[0] << " Get ops/s,"
+       << read_modes[1] << " Get ops/s" << endl;
+  for (int i = 0; i < 7; i++) {
+    cout << (int)pow(2, i) << "," << get_throughputs[0][i] << ","
+         << get_throughputs[1][i] << endl;
+  }
+
+  deleteAllFilesInDirectory(dir_path);
+}
+
+void experiment5() {
+  deleteAllFilesInDirectory("experiments/ssts/eviction");
+  // Compare bufferpool eviction policies on a workload mixing Gets on a hot
+  // set of keys with long scans over the whole database, which flush an LRU
+  // bufferpool of its hot pages
+  int MB = 1048576;
+  int memtable_size = MB / 16;     // 1MB memtable, in 16 byte entries
+  int bufferpool_capacity = 2560;  // 10MB bufferpool, in pages
+  int num_keys = 64 * MB / 16;     // 64MB database
+  int hot_keys = num_keys / 20;    // 5% of keys get 90% of the Gets
+  int scan_length = MB / 16;       // 1MB scans
+  string dir_path = "experiments/ssts/eviction";
+  const char *policies[] = {LRU_POLICY, CLOCK_POLICY, ARC_POLICY};
+
+  Database writer(memtable_size, bufferpool_capacity);
+  writer.Open(dir_path, BSST);
+  cout << "Inserting " << num_keys * 16 / MB << " MB" << endl;
+  for (int key = 1; key <= num_keys; key++) {
+    writer.Put(key, key);
+  }
+  writer.Close();
+
+  // Pre-generating the workload, a scan start or -1 for every 100th
+  // operation and a key to Get otherwise
+  const unsigned int seed = 123456789;
+  mt19937 gen(seed);
+  uniform_int_distribution<> hot_distrib(1, hot_keys);
+  uniform_int_distribution<> cold_distrib(1, num_keys);
+  uniform_int_distribution<> percent(0, 99);
+  int num_ops = 200000;
+  vector<int> keys(num_ops);
+  vector<bool> is_scan(num_ops);
+  for (int j = 0; j < num_ops; j++) {
+    is_scan[j] = j % 100 == 99;
+    if (is_scan[j]) {
+      keys[j] = cold_distrib(gen);
+    } else {
+      keys[j] = percent(gen) < 90 ? hot_distrib(gen) : cold_distrib(gen);
+    }
+  }
+
+  cout << "Throughput:" << endl;
+  cout << "eviction policy,ops/s" << endl;
+  for (const char *policy : policies) {
+    Database reader(memtable_size, bufferpool_capacity, 10, DIRECT_IO, policy);
+    reader.Open(dir_path, BSST);
+
+    auto start = chrono::steady_clock::now();
+    for (int j = 0; j < num_ops; j++) {
+      if (is_scan[j]) {
+        reader.Scan(keys[j], keys[j] + scan_length);
+      } else {
+        reader.Get(keys[j]);
+      }
+    }
+    auto stop = chrono::steady_clock::now();
+    auto duration = chrono::duration<double>(stop - start).count();
+    cout << policy << "," << num_ops / duration << endl;
+
+    reader.Close();
+  }
+
+  deleteAllFilesInDirectory(dir_path);
+}
+
+void experiment6() {
+  // Hit throughput of the bufferpool when several threads pin resident
+  // pages at once, with a single latch against one latch per shard
+  int bufferpool_capacity = 2560;  // 10MB bufferpool, in pages
+  int num_pages = bufferpool_capacity / 2;
+  int pins_per_thread = 1000000;
+  size_t shard_counts[] = {1, 16};
+  int max_threads = max(1u, thread::hardware_concurrency());
+
+  cout << "Pin Throughput:" << endl;
+  cout << "threads,1 shard pins/s,16 shards pins/s" << endl;
+  for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+    cout << num_threads;
+    for (size_t num_shards : shard_counts) {
+      Bufferpool bufferpool(bufferpool_capacity, LRU_POLICY, num_shards);
+      vector<KeyValuePair> page(PAGE_NUM_ENTRIES);
+      for (int i = 0; i < num_pages; i++) {
+        bufferpool.insert(make_page_id(0, i), page);
+      }
+
+      vector<thread> threads;
+      auto start = chrono::steady_clock::now();
+      for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&bufferpool, num_pages, pins_per_thread, t]() {
+          mt19937 gen(t);
+          uniform_int_distribution<> distrib(0, num_pages - 1);
+          for (int j = 0; j < pins_per_thread; j++) {
+            PageHandle handle = bufferpool.pin(make_page_id(0, distrib(gen)));
+          }
+        });
+      }
+      for (auto &t : threads) {
+        t.join();
+      }
+      auto stop = chrono::steady_clock::now();
+      auto duration = chrono::duration<double>(stop - start).count();
+      cout << "," << (double)num_threads * pins_per_thread / duration;
+    }
+    cout << endl;
+  }
+}
+
+void experiment7() {
+  // Put and Get throughput of the AVL tree memtable against the skiplist
+  // memtable, in memory and through a database that flushes BSSTs
+  int MB = 1048576;
+  int num_keys = MB;  // 16MB of entries
+  const char *memtable_types[] = {AVL_MEMTABLE, SKIPLIST_MEMTABLE};
+
+  mt19937 gen(123456789);
+  uniform_int_distribution<int64_t> distrib(1, 1LL << 40);
+  vector<int64_t> keys(num_keys);
+  for (auto &key : keys) {
+    key = distrib(gen);
+  }
+
+  cout << "In-memory Throughput:" << endl;
+  cout << "memtable type,puts/s,gets/s" << endl;
+  for (const char *type : memtable_types) {
+    Memtable memtable(num_keys + 1, 10, type);
+    auto start = chrono::steady_clock::now();
+    for (int64_t key : keys) {
+      memtable.put(key, key);
+    }
+    auto middle = chrono::steady_clock::now();
+    for (int64_t key : keys) {
+      memtable.get(key);
+    }
+    auto stop = chrono::steady_clock::now();
+    cout << type << ","
+         << num_keys / chrono::duration<double>(middle - start).count() << ","
+         << num_keys / chrono::duration<double>(stop - middle).count() << endl;
+  }
+
+  cout << "Concurrent Skiplist Put Throughput:" << endl;
+  cout << "threads,puts/s" << endl;
+  int max_threads = max(1u, thread::hardware_concurrency());
+  for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+    Memtable memtable(num_keys + 1, 10, SKIPLIST_MEMTABLE);
+    vector<thread> threads;
+    auto start = chrono::steady_clock::now();
+    for (int t = 0; t < num_threads; t++) {
+      threads.emplace_back([&memtable, &keys, num_threads, t]() {
+        for (size_t j = t; j < keys.size(); j += num_threads) {
+          memtable.put(keys[j], keys[j]);
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    auto stop = chrono::steady_clock::now();
+    cout << num_threads << ","
+         << num_keys / chrono::duration<double>(stop - start).count() << endl;
+  }
+
+  cout << "Database Put Throughput (1MB memtable, BSST):" << endl;
+  cout << "memtable type,puts/s" << endl;
+  string dir_path = "experiments/ssts/memtable";
+  for (const char *type : memtable_types) {
+    deleteAllFilesInDirectory(dir_path);
+    Database database(MB / 16, 0, 10, DIRECT_IO, LRU_POLICY, type);
+    database.Open(dir_path, BSST);
+    auto start = chrono::steady_clock::now();
+    for (int64_t key : keys) {
+      database.Put(key, key);
+    }
+    auto stop = chrono::steady_clock::now();
+    cout << type << ","
+         << num_keys / chrono::duration<double>(stop - start).count() << endl;
+    database.Close();
+  }
+  deleteAllFilesInDirectory(dir_path);
+}
+
+void experiment8() {
+  // Put latency when full memtables are flushed by Put itself against a
+  // background flush thread, with up to 2 full memtables queued
+  int MB = 1048576;
+  int num_keys = MB;  // 16MB of entries
+
+  mt19937 gen(123456789);
+  uniform_int_distribution<int64_t> distrib(1, 1LL << 40);
+  vector<int64_t> keys(num_keys);
+  for (auto &key : keys) {
+    key = distrib(gen);
+  }
+
+  cout << "Put Latency (1MB memtable, BSST):" << endl;
+  cout << "flush,puts/s,p50 us,p99 us,p99.99 us,max us" << endl;
+  string dir_path = "experiments/ssts/background-flush";
+  for (bool background : {false, true}) {
+    deleteAllFilesInDirectory(dir_path);
+    Database database(MB / 16, 0);
+    database.Open(dir_path, BSST);
+    database.set_background_flush(background);
+    vector<double> latencies(num_keys);
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < num_keys; i++) {
+      auto put_start = chrono::steady_clock::now();
+      database.Put(keys[i], keys[i]);
+      latencies[i] = chrono::duration<double, micro>(
+                         chrono::steady_clock::now() - put_start)
+                         .count();
+    }
+    auto stop = chrono::steady_clock::now();
+    database.Close();
+
+    sort(latencies.begin(), latencies.end());
+    cout << (background ? "background" : "synchronous") << ","
+         << num_keys / chrono::duration<double>(stop - start).count() << ","
+         << latencies[num_keys / 2] << "," << latencies[num_keys * 99 / 100]
+         << "," << latencies[(size_t)num_keys * 9999 / 10000] << ","
+         << latencies.back() << endl;
+  }
+  deleteAllFilesInDirectory(dir_path);
+}
+
 int main() {
   cout << "EXPERIMENT 1" << endl;
   experiment1();
@@ -378,4 +670,14 @@ int main() {
   experiment2();
   cout << "EXPERIMENT 3" << endl;
   experiment3();
+  cout << "EXPERIMENT 4" << endl;
+  experiment4();
+  cout << "EXPERIMENT 5" << endl;
+  experiment5();
+  cout << "EXPERIMENT 6" << endl;
+  experiment6();
+  cout << "EXPERIMENT 7" << endl;
+  experiment7();
+  cout << "EXPERIMENT 8" << endl;
+  experiment8();
 }
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "aggregate_source.hh"
+
+using namespace std;
+
+AggregateSource::AggregateSource(unique_ptr<Iterator> entries, int64_t key1)
+    : db(nullptr),
+      reader(nullptr),
+      entries(std::move(entries)),
+      leaf(0),
+      index(0) {
+  this->entries->Seek(key1);
+  valid = this->entries->Valid();
+}
+
+AggregateSource::AggregateSource(Database &db, TableReader &reader,
+                                 int64_t key1)
+    : db(&db), reader(&reader), leaf(0), index(0) {
+  // Binary search the first leaf whose last key is >= key1
+  size_t left = 0;
+  size_t right = reader.leaf_summaries.size();
+  while (left < right) {
+    size_t mid = left + (right - left) / 2;
+    if (reader.leaf_summaries[mid].last_key < key1) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  leaf = left;
+  valid = leaf < reader.leaf_summaries.size();
+}
+
+int64_t AggregateSource::key() const {
+  if (entries) {
+    return entries->key();
+  }
+  return page ? page[index].key : summary().first_key;
+}
+
+int64_t AggregateSource::value() const {
+  return entries ? entries->value() : page[index].value;
+}
+
+void AggregateSource::skip_leaf() {
+  page.release();
+  index = 0;
+  leaf++;
+  valid = leaf < reader->leaf_summaries.size();
+}
+
+void AggregateSource::read_leaf() {
+  page = db->read_page(*reader,
+                       reader->metadata.entries_offset + leaf * PAGE_SIZE,
+                       SCAN_ACCESS);
+  index = 0;
+}
+
+void AggregateSource::Next() {
+  if (entries) {
+    entries->Next();
+    valid = entries->Valid();
+    return;
+  }
+  index++;
+  // The rest of the leaf is padding
+  if (index >= PAGE_NUM_ENTRIES || page[index].key == 0) {
+    skip_leaf();
+  }
+}
@@ -0,0 +1,79 @@
+#ifndef AGGREGATE_SOURCE_HH_
+#define AGGREGATE_SOURCE_HH_
+
+#include <cstdint>
+#include <memory>
+
+#include "database.hh"
+#include "iterator.hh"
+
+class AggregateSource {
+  /**
+   * One source of Database::Aggregate, walked in ascending key order.
+   *
+   * The memtable and SSTs without leaf summaries are walked entry by entry
+   * with an Iterator. BSSTs with leaf summaries are walked leaf by leaf: the
+   * source stops at each leaf before reading it (at_leaf), and the caller
+   * either counts the whole leaf from its summary with skip_leaf or reads it
+   * with read_leaf and walks its entries.
+   */
+  Database *db;
+  TableReader *reader;                // SST walked by leaf, null otherwise
+  std::unique_ptr<Iterator> entries;  // source walked by entry, if any
+  size_t leaf;                        // index of the current leaf
+  PageHandle page;                    // current leaf once read
+  int index;                          // index of the current entry in page
+  bool valid;
+
+ public:
+  /**
+   * Walk entries from the first one with a key >= key1.
+   */
+  AggregateSource(std::unique_ptr<Iterator> entries, int64_t key1);
+
+  /**
+   * Walk the leaves of reader from the one that may hold key1. The leaf
+   * summaries of reader must be loaded.
+   */
+  AggregateSource(Database &db, TableReader &reader, int64_t key1);
+
+  bool Valid() const { return valid; }
+
+  /**
+   * Return true if the source is at a leaf that has not been read yet.
+   */
+  bool at_leaf() const { return reader != nullptr && !page; }
+
+  /**
+   * Return the summary of the current leaf. The source must be at a leaf.
+   */
+  const LeafSummary &summary() const { return reader->leaf_summaries[leaf]; }
+
+  /**
+   * Return the key of the current entry, or the first key of the current
+   * leaf if it has not been read yet.
+   */
+  int64_t key() const;
+
+  /**
+   * Return the value of the current entry. The source must not be at a leaf.
+   */
+  int64_t value() const;
+
+  /**
+   * Move to the next leaf without reading the rest of the current one.
+   */
+  void skip_leaf();
+
+  /**
+   * Read the current leaf and move to its first entry.
+   */
+  void read_leaf();
+
+  /**
+   * Move to the next entry. The source must not be at a leaf.
+   */
+  void Next();
+};
+
+#endif  // AGGREGATE_SOURCE_HH_
@@ -0,0 +1,37 @@
+#include "arena.hh"
+
+#include "constants.hh"
+
+using namespace std;
+
+Arena::Arena() : current(nullptr), memory_usage(0) {}
+
+void Arena::add_block(Block *full, size_t bytes) {
+  lock_guard<mutex> guard(latch);
+  if (current.load() != full) {
+    // Another thread added a block in the meantime
+    return;
+  }
+  unique_ptr<Block> block(new Block());
+  block->size = max<size_t>(bytes, ARENA_BLOCK_SIZE);
+  block->data.reset(new char[block->size]);
+  block->used = 0;
+  memory_usage += block->size;
+  current = block.get();
+  blocks.push_back(std::move(block));
+}
+
+char *Arena::allocate(size_t bytes) {
+  // Keep every allocation aligned for the atomics of skiplist nodes
+  bytes = (bytes + 7) & ~(size_t)7;
+  while (true) {
+    Block *block = current.load();
+    if (block) {
+      size_t offset = block->used.fetch_add(bytes);
+      if (offset + bytes <= block->size) {
+        return block->data.get() + offset;
+      }
+    }
+    add_block(block, bytes);
+  }
+}
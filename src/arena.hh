@@ -0,0 +1,52 @@
+#ifndef ARENA_HH_
+#define ARENA_HH_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class Arena {
+  /**
+   * Bump allocator for the nodes of a memtable. Memory is carved out of
+   * blocks of ARENA_BLOCK_SIZE bytes with an atomic add, so threads allocate
+   * without taking a lock except when a block runs out. Nothing is freed on
+   * its own: every block is released at once when the arena is destroyed.
+   */
+  struct Block {
+    std::unique_ptr<char[]> data;
+    size_t size;                // bytes in data
+    std::atomic<size_t> used;   // bytes handed out, may exceed size
+  };
+
+  std::vector<std::unique_ptr<Block>> blocks;  // every block, guarded by latch
+  std::atomic<Block *> current;                // block being carved up
+  std::atomic<size_t> memory_usage;            // bytes of all blocks
+  std::mutex latch;                            // Guards blocks
+
+  /**
+   * Make a block of at least bytes bytes current, unless another thread
+   * already replaced full.
+   */
+  void add_block(Block *full, size_t bytes);
+
+ public:
+  Arena();
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  /**
+   * Return bytes bytes aligned to 8 bytes. Throws bad_alloc if a new block
+   * cannot be allocated. Safe to call from several threads.
+   */
+  char *allocate(size_t bytes);
+
+  /**
+   * Return the number of bytes allocated from the system.
+   */
+  size_t get_memory_usage() const { return memory_usage.load(); }
+};
+
+#endif  // ARENA_HH_
@@ -0,0 +1,220 @@
+#include "async_page_reader.hh"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+using namespace std;
+
+AsyncPageReader::AsyncPageReader(unsigned queue_depth)
+    : ring_fd(-1),
+      queue_depth(queue_depth),
+      sq_ring(nullptr),
+      sq_ring_size(0),
+      sq_head(nullptr),
+      sq_tail(nullptr),
+      sq_mask(nullptr),
+      sq_array(nullptr),
+      sqes(nullptr),
+      sqes_size(0),
+      cq_ring(nullptr),
+      cq_ring_size(0),
+      cq_head(nullptr),
+      cq_tail(nullptr),
+      cq_mask(nullptr),
+      cqes(nullptr) {
+  setup();
+}
+
+AsyncPageReader::~AsyncPageReader() {
+  if (sqes) munmap(sqes, sqes_size);
+  if (cq_ring && cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+  if (sq_ring) munmap(sq_ring, sq_ring_size);
+  if (ring_fd != -1) close(ring_fd);
+}
+
+bool AsyncPageReader::is_async() const { return ring_fd != -1; }
+
+void AsyncPageReader::setup() {
+#ifdef HAVE_IO_URING
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = (int)syscall(__NR_io_uring_setup, queue_depth, &params);
+  if (fd < 0) {
+    // io_uring is not supported here, use pread instead
+    return;
+  }
+  queue_depth = params.sq_entries;
+
+  sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    sq_ring_size = cq_ring_size = max(sq_ring_size, cq_ring_size);
+  }
+
+  sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sq_ring == MAP_FAILED) {
+    sq_ring = nullptr;
+    close(fd);
+    return;
+  }
+  if (single_mmap) {
+    cq_ring = sq_ring;
+  } else {
+    cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED) {
+      cq_ring = nullptr;
+      munmap(sq_ring, sq_ring_size);
+      sq_ring = nullptr;
+      close(fd);
+      return;
+    }
+  }
+  sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    sqes = nullptr;
+    if (cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+    munmap(sq_ring, sq_ring_size);
+    sq_ring = cq_ring = nullptr;
+    close(fd);
+    return;
+  }
+
+  char *sq = static_cast<char *>(sq_ring);
+  sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+  char *cq = static_cast<char *>(cq_ring);
+  cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes = cq + params.cq_off.cqes;
+
+  ring_fd = fd;
+#endif
+}
+
+void AsyncPageReader::submit_and_wait(vector<PageRead> &reads, size_t begin,
+                                      size_t end) {
+#ifdef HAVE_IO_URING
+  struct io_uring_sqe *sqe_array = static_cast<struct io_uring_sqe *>(sqes);
+  struct io_uring_cqe *cqe_array = static_cast<struct io_uring_cqe *>(cqes);
+  vector<struct iovec> iovecs(end - begin);
+
+  // Fill one submission queue entry per read
+  const unsigned first = *sq_tail;
+  unsigned tail = first;
+  for (size_t i = begin; i < end; i++) {
+    unsigned index = tail & *sq_mask;
+    struct io_uring_sqe *sqe = &sqe_array[index];
+    memset(sqe, 0, sizeof(*sqe));
+
+    iovecs[i - begin].iov_base = reads[i].buffer;
+    iovecs[i - begin].iov_len = PAGE_SIZE;
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = reads[i].fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&iovecs[i - begin]);
+    sqe->len = 1;
+    sqe->off = reads[i].offset;
+    sqe->user_data = i;
+
+    sq_array[index] = index;
+    tail++;
+  }
+  // Publish the new tail to the kernel
+  __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+  unsigned to_submit = (unsigned)(end - begin);
+  unsigned completed = 0;
+  auto reap = [&]() {
+    unsigned head = *cq_head;
+    while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+      struct io_uring_cqe *cqe = &cqe_array[head & *cq_mask];
+      reads[cqe->user_data].result = cqe->res;
+      completed++;
+      head++;
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+  };
+
+  while (completed < end - begin) {
+    int ret = (int)syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                           (unsigned)(end - begin) - completed,
+                           IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      int error = errno;
+      // Take back the entries the kernel has not consumed, so a later batch
+      // does not submit them
+      unsigned consumed = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+      __atomic_store_n(sq_tail, consumed, __ATOMIC_RELEASE);
+      unsigned submitted = consumed - first;
+
+      // Reads already submitted may still write into their buffers, wait
+      // for all of them before reading anything again
+      while (completed < submitted) {
+        if (syscall(__NR_io_uring_enter, ring_fd, 0, submitted - completed,
+                    IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+            errno != EINTR) {
+          break;
+        }
+        reap();
+      }
+
+      for (size_t i = begin; i < end; i++) {
+        if (reads[i].result != -EINPROGRESS) {
+          continue;
+        }
+        if (i - begin < submitted) {
+          // Still in flight, its buffer cannot be read into safely
+          reads[i].result = -error;
+        } else {
+          reads[i].result =
+              pread(reads[i].fd, reads[i].buffer, PAGE_SIZE, reads[i].offset);
+        }
+      }
+      return;
+    }
+    to_submit -= min((unsigned)ret, to_submit);
+    reap();
+  }
+#else
+  (void)reads;
+  (void)begin;
+  (void)end;
+#endif
+}
+
+void AsyncPageReader::read_pages(vector<PageRead> &reads) {
+  if (!is_async()) {
+    for (auto &read : reads) {
+      read.result = pread(read.fd, read.buffer, PAGE_SIZE, read.offset);
+    }
+    return;
+  }
+
+  for (auto &read : reads) {
+    read.result = -EINPROGRESS;
+  }
+  for (size_t begin = 0; begin < reads.size(); begin += queue_depth) {
+    size_t end = min(reads.size(), begin + queue_depth);
+    submit_and_wait(reads, begin, end);
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef ASYNC_PAGE_READER_HH_
+#define ASYNC_PAGE_READER_HH_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "constants.hh"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+/**
+ * @brief One page read handed to the AsyncPageReader.
+ */
+struct PageRead {
+  int fd;          // file to read from
+  int64_t offset;  // offset of the page in the file
+  void *buffer;    // destination, PAGE_SIZE bytes
+  ssize_t result;  // bytes read, or -errno once the read completes
+};
+
+class AsyncPageReader {
+  /**
+   * Reads batches of pages with io_uring, set up through raw syscalls so no
+   * external library is needed. All reads of a batch are submitted together
+   * and completed together, so their device latencies overlap instead of
+   * adding up.
+   *
+   * When io_uring is not available (old kernel, seccomp, non-Linux build)
+   * the reader falls back to one blocking pread per page.
+   */
+  int ring_fd;
+  unsigned queue_depth;
+
+  // Submission queue
+  void *sq_ring;
+  size_t sq_ring_size;
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+  void *sqes;  // struct io_uring_sqe[queue_depth]
+  size_t sqes_size;
+
+  // Completion queue
+  void *cq_ring;
+  size_t cq_ring_size;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  void *cqes;  // struct io_uring_cqe[]
+
+  /**
+   * Set up the ring. Leaves ring_fd at -1 if io_uring is unavailable.
+   */
+  void setup();
+
+  /**
+   * Submit at most queue_depth reads and wait for all of them to complete.
+   * If io_uring_enter fails, the reads the kernel never took are done with
+   * pread once the submitted ones have completed. A submitted read that
+   * cannot be waited for fails with the error.
+   */
+  void submit_and_wait(std::vector<PageRead> &reads, size_t begin,
+                       size_t end);
+
+ public:
+  explicit AsyncPageReader(unsigned queue_depth = ASYNC_QUEUE_DEPTH);
+  ~AsyncPageReader();
+
+  AsyncPageReader(const AsyncPageReader &) = delete;
+  AsyncPageReader &operator=(const AsyncPageReader &) = delete;
+
+  /**
+   * Return true if reads go through io_uring, false if they fall back to
+   * pread.
+   */
+  bool is_async() const;
+
+  /**
+   * Read every page of reads and block until all of them completed. The
+   * outcome of each read is stored in its result field.
+   */
+  void read_pages(std::vector<PageRead> &reads);
+};
+
+#endif  // ASYNC_PAGE_READER_HH_
@@ -3,26 +3,87 @@
 //
 #include "bloom-filter.hh"
 
+#include <cstring>
 #include <iostream>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include "MurmurHash3.hh"
 
-BloomFilter::BloomFilter(int64_t num_entries, int64_t custom_bits_per_entry)
-    : num_entries(num_entries), M(custom_bits_per_entry) {
+BloomFilter::BloomFilter(int64_t num_entries, int64_t custom_bits_per_entry,
+                         int64_t filter_type)
+    : num_entries(num_entries),
+      M(custom_bits_per_entry),
+      filter_type(filter_type) {
   init();
 }
 
 BloomFilter::BloomFilter(vector<int64_t> filter, int64_t num_entries,
-                         int64_t bits_per_entry, vector<int64_t> seeds)
+                         int64_t bits_per_entry, vector<int64_t> seeds,
+                         int64_t filter_type)
     : num_entries(num_entries),
       M(bits_per_entry),
       num_bits(num_entries * bits_per_entry),
       filter(filter),
-      num_hash_functions(seeds.size()),
-      seeds(seeds) {}
+      filter_length((int64_t)filter.size()),
+      num_hash_functions(filter_type == BLOCKED_BLOOM_FILTER
+                             ? (int64_t)ceil(log(2) * bits_per_entry)
+                             : (int64_t)seeds.size()),
+      seeds(seeds),
+      filter_type(filter_type) {}
+
+BloomFilter::BloomFilter(const int64_t *filter_view, int64_t filter_length,
+                         int64_t num_entries, int64_t bits_per_entry,
+                         vector<int64_t> seeds, int64_t filter_type)
+    : num_entries(num_entries),
+      M(bits_per_entry),
+      num_bits(num_entries * bits_per_entry),
+      filter_view(filter_view),
+      filter_length(filter_length),
+      num_hash_functions(filter_type == BLOCKED_BLOOM_FILTER
+                             ? (int64_t)ceil(log(2) * bits_per_entry)
+                             : (int64_t)seeds.size()),
+      seeds(seeds),
+      filter_type(filter_type) {}
+
+int64_t BloomFilter::block_index(uint32_t hash) const {
+  // Map hash to [0, num_blocks) without a division
+  uint64_t num_blocks = filter_length / BLOOM_BLOCK_WORDS;
+  return (int64_t)(((uint64_t)hash * num_blocks) >> 32);
+}
+
+void BloomFilter::block_mask(uint32_t hash,
+                             uint64_t mask[BLOOM_BLOCK_WORDS]) const {
+  memset(mask, 0, BLOOM_BLOCK_WORDS * sizeof(uint64_t));
+  // Remix the hash into two 32-bit halves and walk a + i * b, using the top 9
+  // bits of each step as the bit position within the 512-bit block
+  uint64_t remixed = (uint64_t)hash * 0x9E3779B97F4A7C15ULL;
+  uint32_t a = (uint32_t)(remixed >> 32);
+  uint32_t b = (uint32_t)remixed | 1;
+  for (int i = 0; i < num_hash_functions; i++) {
+    uint32_t bit = a >> 23;
+    mask[bit >> 6] |= 1ULL << (bit & 63);
+    a += b;
+  }
+}
 
 void BloomFilter::insert(int64_t key) {
   uint32_t hash_output;
+  if (filter_type == BLOCKED_BLOOM_FILTER) {
+    MurmurHash3_x86_32(&key, INT64_T_SIZE, seeds[0], &hash_output);
+    int64_t block = block_index(hash_output) * BLOOM_BLOCK_WORDS;
+    if (block < 0 || block + BLOOM_BLOCK_WORDS > (int64_t)filter.size())
+      throw invalid_argument("Block in BloomFilter::insert out of bounds");
+    uint64_t mask[BLOOM_BLOCK_WORDS];
+    block_mask(hash_output, mask);
+    for (int i = 0; i < BLOOM_BLOCK_WORDS; i++) {
+      filter[block + i] |= (int64_t)mask[i];
+    }
+    return;
+  }
+
   for (int i = 0; i < num_hash_functions; i++) {
     MurmurHash3_x86_32(&key, INT64_T_SIZE, seeds[i], &hash_output);
     int index = hash_output % num_bits;
@@ -32,7 +93,40 @@ void BloomFilter::insert(int64_t key) {
   }
 }
 
+bool BloomFilter::blocked_includes(int64_t key) {
+  const int64_t *words = filter_view ? filter_view : filter.data();
+  uint32_t hash_output;
+  MurmurHash3_x86_32(&key, INT64_T_SIZE, seeds[0], &hash_output);
+  int64_t block = block_index(hash_output) * BLOOM_BLOCK_WORDS;
+  if (block < 0 || block + BLOOM_BLOCK_WORDS > filter_length)
+    throw invalid_argument(
+        "Block in BloomFilter::blocked_includes out of bounds");
+
+  uint64_t mask[BLOOM_BLOCK_WORDS];
+  block_mask(hash_output, mask);
+  const int64_t *block_words = words + block;
+#ifdef __AVX2__
+  // The key may be in the set only if no bit of the mask is clear in block
+  __m256i low = _mm256_loadu_si256((const __m256i *)block_words);
+  __m256i high = _mm256_loadu_si256((const __m256i *)(block_words + 4));
+  __m256i mask_low = _mm256_loadu_si256((const __m256i *)mask);
+  __m256i mask_high = _mm256_loadu_si256((const __m256i *)(mask + 4));
+  return _mm256_testc_si256(low, mask_low) &&
+         _mm256_testc_si256(high, mask_high);
+#else
+  uint64_t missing = 0;
+  for (int i = 0; i < BLOOM_BLOCK_WORDS; i++) {
+    missing |= mask[i] & ~(uint64_t)block_words[i];
+  }
+  return missing == 0;
+#endif
+}
+
 bool BloomFilter::includes(int64_t key) {
+  if (filter_type == BLOCKED_BLOOM_FILTER) {
+    return blocked_includes(key);
+  }
+  const int64_t *words = filter_view ? filter_view : filter.data();
   uint32_t hash_output;
   for (int i = 0; i < num_hash_functions; ++i) {
     MurmurHash3_x86_32(&key, INT64_T_SIZE, seeds[i], &hash_output);
@@ -40,7 +134,7 @@ bool BloomFilter::includes(int64_t key) {
     if (index < 0 || index >= num_bits)
       throw invalid_argument("Index in BloomFilter::includes out of bounds");
     size_t filter_index = index / 64;
-    if (filter_index >= filter.size() || filter_index < 0)
+    if (filter_index >= (size_t)filter_length || filter_index < 0)
       throw invalid_argument(
           "filter_index in BloomFilter::includes out of bounds");
     int bit_index = index % 64;
@@ -48,7 +142,7 @@ bool BloomFilter::includes(int64_t key) {
       throw invalid_argument(
           "bit_index in in BloomFilter::includes out of bounds");
 
-    if (!(filter[filter_index] & (1LL << bit_index))) {
+    if (!(words[filter_index] & (1LL << bit_index))) {
       // If any bit is not set, the item is definitely not in the set
       return false;
     }
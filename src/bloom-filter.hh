@@ -21,23 +21,34 @@ class BloomFilter {
   int64_t M;  // Bits per entry
   int64_t num_bits;
   vector<int64_t> filter;
+  const int64_t *filter_view = nullptr;  // filter words owned by someone else
+  int64_t filter_length;                 // number of words in the filter
   int64_t num_hash_functions;
   vector<int64_t> seeds;
+  int64_t filter_type;  // STANDARD_BLOOM_FILTER or BLOCKED_BLOOM_FILTER
 
   void init() {
     if (num_entries <= 0) throw invalid_argument("num_entries must be > 0");
     if (M <= 0) throw invalid_argument("Bits per entry must be > 0");
     num_bits = num_entries * M;
-    filter.resize(ceil((double)num_bits / 64), 0);
     num_hash_functions = (int64_t)ceil((log(2)) * M);
-    seeds.resize(num_hash_functions);
+    if (filter_type == BLOCKED_BLOOM_FILTER) {
+      // Whole blocks only, and a single seed since keys are hashed once
+      int64_t block_bits = BLOOM_BLOCK_WORDS * 64;
+      int64_t num_blocks = (num_bits + block_bits - 1) / block_bits;
+      filter.resize(num_blocks * BLOOM_BLOCK_WORDS, 0);
+      seeds.resize(1);
+    } else {
+      filter.resize(ceil((double)num_bits / 64), 0);
+      seeds.resize(num_hash_functions);
+    }
+    filter_length = (int64_t)filter.size();
 
     random_device rd;
     mt19937 gen(rd());
-    for (int i = 0; i < num_hash_functions; ++i) {
+    for (size_t i = 0; i < seeds.size(); ++i) {
       seeds[i] = gen();
     }
-    assert(num_hash_functions == (int)seeds.size());
   }
 
   void setBit(int index) {
@@ -50,13 +61,35 @@ class BloomFilter {
     filter[filter_index] |= (1LL << bit_index);
   }
 
+  /**
+   * Blocked filter: index of the block hash falls into.
+   */
+  int64_t block_index(uint32_t hash) const;
+
+  /**
+   * Blocked filter: set in mask the num_hash_functions bits that hash probes
+   * inside its block. All probe bits are derived from the one hash.
+   */
+  void block_mask(uint32_t hash, uint64_t mask[BLOOM_BLOCK_WORDS]) const;
+
+  bool blocked_includes(int64_t key);
+
  public:
   // Constructor for flushing to SST
-  explicit BloomFilter(int64_t num_entries, int64_t custom_bits_per_entry = 10);
+  explicit BloomFilter(int64_t num_entries, int64_t custom_bits_per_entry = 10,
+                       int64_t filter_type = STANDARD_BLOOM_FILTER);
 
   // Constructor for reading filter from SST
   BloomFilter(vector<int64_t> filter, int64_t num_entries,
-              int64_t bits_per_entry, vector<int64_t> seeds);
+              int64_t bits_per_entry, vector<int64_t> seeds,
+              int64_t filter_type = STANDARD_BLOOM_FILTER);
+
+  // Constructor for probing a filter in place, e.g. in a memory-mapped SST.
+  // filter_view must outlive the BloomFilter.
+  BloomFilter(const int64_t *filter_view, int64_t filter_length,
+              int64_t num_entries, int64_t bits_per_entry,
+              vector<int64_t> seeds,
+              int64_t filter_type = STANDARD_BLOOM_FILTER);
 
   // Getter methods
   int64_t get_num_entries() const { return num_entries; }
@@ -67,6 +100,8 @@ class BloomFilter {
 
   int64_t get_num_hash_functions() const { return num_hash_functions; }
 
+  int64_t get_filter_type() const { return filter_type; }
+
   // Returns number of uint64_t (8-byte) integers used to store bits
   int64_t get_filter_size() { return (int64_t)filter.size(); }
 
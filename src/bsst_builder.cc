@@ -0,0 +1,210 @@
+#include "bsst_builder.hh"
+
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+
+BSSTBuilder::BSSTBuilder(const string &filename, int64_t max_entries,
+                         int64_t bits_per_entry, int64_t filter_type)
+    : outFile(filename, ios::binary),
+      bloom_filter(max_entries, bits_per_entry, filter_type),
+      max_entries(max_entries),
+      num_added(0),
+      page(2 * PAGE_NUM_ENTRIES, 0),
+      num_in_page(0),
+      min_key(0),
+      max_key(0) {
+  if (!outFile) {
+    cerr << "Could not open file for writing.\n";
+    throw runtime_error("Could not open file for writing.");
+  }
+
+  // Leave room for the metadata page and the internal pages
+  entries_offset =
+      leaves_offset((max_entries + PAGE_NUM_ENTRIES - 1) / PAGE_NUM_ENTRIES);
+  outFile.seekp(entries_offset);
+}
+
+vector<int64_t> BSSTBuilder::group_sizes(int64_t count) {
+  int64_t num_nodes = (count + PAGE_NUM_ENTRIES - 1) / PAGE_NUM_ENTRIES;
+  // The first nodes take one child more when count does not split evenly
+  vector<int64_t> sizes(num_nodes, count / num_nodes);
+  for (int64_t i = 0; i < count % num_nodes; i++) {
+    sizes[i]++;
+  }
+  return sizes;
+}
+
+vector<int64_t> BSSTBuilder::internal_level_sizes(int64_t num_leaves) {
+  vector<int64_t> sizes;
+  if (num_leaves <= 1) {
+    // The only leaf is the root
+    return sizes;
+  }
+  int64_t count = num_leaves;
+  do {
+    count = (int64_t)group_sizes(count).size();
+    sizes.push_back(count);
+  } while (count > PAGE_NUM_ENTRIES);
+  if (count > 1) {
+    // A root above the last level
+    sizes.push_back(1);
+  }
+  return sizes;
+}
+
+int64_t BSSTBuilder::leaves_offset(int64_t num_leaves) {
+  int64_t num_internal = 0;
+  for (int64_t level_size : internal_level_sizes(num_leaves)) {
+    num_internal += level_size;
+  }
+  return (1 + num_internal) * PAGE_SIZE;
+}
+
+void BSSTBuilder::write_page() {
+  fill(page.begin() + 2 * num_in_page, page.end(), 0);
+  outFile.write(reinterpret_cast<const char *>(page.data()), PAGE_SIZE);
+  if (!outFile) {
+    cerr << "Write error occurred.\n";
+  }
+  num_in_page = 0;
+}
+
+int64_t BSSTBuilder::write_padded(const vector<int64_t> &values) {
+  int64_t bytes = (int64_t)values.size() * sizeof(int64_t);
+  outFile.write(reinterpret_cast<const char *>(values.data()), bytes);
+  int64_t padding = (PAGE_SIZE - bytes % PAGE_SIZE) % PAGE_SIZE;
+  vector<char> zeroes(padding, 0);
+  outFile.write(zeroes.data(), padding);
+  return bytes + padding;
+}
+
+void BSSTBuilder::add(int64_t key, int64_t value) {
+  if (num_added == max_entries) {
+    throw logic_error("BSSTBuilder: more pairs than max_entries");
+  }
+  num_added++;
+  bloom_filter.insert(key);
+  if (min_key == 0) {
+    min_key = key;
+  }
+  max_key = key;
+
+  if (num_in_page == 0) {
+    leaf_summaries.push_back(LeafSummary{key, key, 0, 0, 0, 0});
+  }
+  LeafSummary &leaf = leaf_summaries.back();
+  leaf.last_key = key;
+  // A value of 0 marks a deleted key
+  if (value != 0) {
+    leaf.min = leaf.count == 0 ? value : min(leaf.min, value);
+    leaf.max = leaf.count == 0 ? value : max(leaf.max, value);
+    leaf.count++;
+    leaf.sum += value;
+  }
+
+  page[2 * num_in_page] = key;
+  page[2 * num_in_page + 1] = value;
+  num_in_page++;
+  if (num_in_page == PAGE_NUM_ENTRIES) {
+    leaf_max_keys.push_back(key);
+    write_page();
+  }
+}
+
+void BSSTBuilder::finish() {
+  if (num_added == 0) {
+    throw logic_error("BSSTBuilder: no pairs added");
+  }
+  if (num_in_page > 0) {
+    leaf_max_keys.push_back(max_key);
+    write_page();
+  }
+  int64_t filter_offset =
+      entries_offset + (int64_t)leaf_max_keys.size() * PAGE_SIZE;
+
+  // Bloom filter, its seeds, then the leaf summaries, each starting on a
+  // new page
+  vector<int64_t> seeds = bloom_filter.get_seeds();
+  outFile.seekp(filter_offset);
+  int64_t seeds_offset = filter_offset + write_padded(bloom_filter.get_filter());
+  int64_t summaries_offset = seeds_offset + write_padded(seeds);
+
+  // LEAF_SUMMARY_ENTRIES KV-pairs each so they never straddle a page
+  const size_t summaries_per_page = PAGE_NUM_ENTRIES / LEAF_SUMMARY_ENTRIES;
+  int64_t file_size = summaries_offset;
+  for (size_t i = 0; i < leaf_summaries.size(); i += summaries_per_page) {
+    vector<int64_t> fields;
+    for (size_t j = i; j < leaf_summaries.size() && j < i + summaries_per_page;
+         j++) {
+      const LeafSummary &leaf = leaf_summaries[j];
+      fields.insert(fields.end(), {leaf.first_key, leaf.last_key, leaf.count,
+                                   leaf.sum, leaf.min, leaf.max});
+    }
+    file_size += write_padded(fields);
+  }
+
+  // Internal levels, built bottom-up from the largest key of every node of
+  // the level below and written top-down from page 1
+  vector<vector<int64_t>> max_keys = {leaf_max_keys};
+  vector<vector<int64_t>> fanouts;
+  vector<int64_t> level_sizes = internal_level_sizes(leaf_max_keys.size());
+  if (level_sizes.empty() && entries_offset > PAGE_SIZE) {
+    // A single leaf after pages reserved for more, the root points to it
+    level_sizes.push_back(1);
+  }
+  for (int64_t level_size : level_sizes) {
+    const vector<int64_t> &below = max_keys.back();
+    vector<int64_t> sizes = level_size == 1
+                                ? vector<int64_t>{(int64_t)below.size()}
+                                : group_sizes(below.size());
+    vector<int64_t> above;
+    int64_t end = 0;
+    for (int64_t size : sizes) {
+      end += size;
+      above.push_back(below[end - 1]);
+    }
+    fanouts.push_back(sizes);
+    max_keys.push_back(above);
+  }
+
+  // First page of every level, leaves first
+  vector<int64_t> first_page(max_keys.size());
+  first_page[0] = entries_offset / PAGE_SIZE;
+  int64_t next_page = 1;
+  for (size_t level = max_keys.size() - 1; level >= 1; level--) {
+    first_page[level] = next_page;
+    next_page += (int64_t)max_keys[level].size();
+  }
+
+  outFile.seekp(PAGE_SIZE);
+  for (size_t level = max_keys.size() - 1; level >= 1; level--) {
+    int64_t child = 0;
+    for (int64_t size : fanouts[level - 1]) {
+      for (int64_t i = 0; i < size; i++, child++) {
+        page[2 * num_in_page] = max_keys[level - 1][child];
+        page[2 * num_in_page + 1] = (first_page[level - 1] + child) * PAGE_SIZE;
+        num_in_page++;
+      }
+      write_page();
+    }
+  }
+
+  vector<int64_t> metadata = {entries_offset,
+                              filter_offset,
+                              seeds_offset,
+                              bloom_filter.get_bits_per_entry(),
+                              num_added,
+                              bloom_filter.get_filter_size(),
+                              (int64_t)seeds.size(),
+                              file_size,
+                              min_key,
+                              max_key,
+                              bloom_filter.get_filter_type(),
+                              summaries_offset,
+                              bloom_filter.get_num_entries()};
+  outFile.seekp(0);
+  write_padded(metadata);
+  outFile.close();
+}
@@ -0,0 +1,93 @@
+#ifndef BSST_BUILDER_HH_
+#define BSST_BUILDER_HH_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "bloom-filter.hh"
+#include "constants.hh"
+#include "table_reader.hh"
+
+class BSSTBuilder {
+  /**
+   * Writes a B-tree SST from KV-pairs added in ascending key order, without
+   * building the tree in memory.
+   *
+   * The file holds the metadata page, the internal pages (root first, one
+   * level after the other), the leaves, the Bloom filter, its seeds and the
+   * leaf summaries. Leaves are written as soon as they are full, after room
+   * for the internal pages of a tree of max_entries entries. Only the
+   * largest key and the summary of each leaf are kept, and finish builds
+   * the internal levels from them bottom-up, so memory grows with the
+   * number of pages rather than entries.
+   *
+   * If fewer than max_entries pairs are added, as when a compaction drops
+   * older versions of keys, the leaves stay where they were written and the
+   * pages reserved beyond the internal pages actually needed are left
+   * unused. The Bloom filter stays sized for max_entries, which the metadata
+   * records apart from the number of pairs actually added.
+   */
+  std::ofstream outFile;
+  BloomFilter bloom_filter;
+  int64_t max_entries;
+  int64_t num_added;
+  int64_t entries_offset;                 // offset of the first leaf
+  std::vector<int64_t> page;              // leaf being filled, key, value...
+  int num_in_page;                        // number of pairs in page
+  std::vector<int64_t> leaf_max_keys;     // largest key of each leaf
+  std::vector<LeafSummary> leaf_summaries;  // summary of each leaf
+  int64_t min_key, max_key;
+
+  /**
+   * Return the number of children of each node of the level above a level
+   * of count nodes, split as evenly as possible into as few nodes as fit
+   * PAGE_NUM_ENTRIES children each.
+   */
+  static std::vector<int64_t> group_sizes(int64_t count);
+
+  /**
+   * Return the number of nodes of each internal level of a tree with
+   * num_leaves leaves, from the level above the leaves up to the root.
+   */
+  static std::vector<int64_t> internal_level_sizes(int64_t num_leaves);
+
+  /**
+   * Return the offset of the first leaf of a tree with num_leaves leaves.
+   */
+  static int64_t leaves_offset(int64_t num_leaves);
+
+  /**
+   * Write the page buffer, zero-padded, and clear it.
+   */
+  void write_page();
+
+  /**
+   * Write values one after the other from the current offset, padding the
+   * last page with zeroes. Return the number of bytes written.
+   */
+  int64_t write_padded(const std::vector<int64_t> &values);
+
+ public:
+  /**
+   * Start writing the BSST filename for at most max_entries (> 0) pairs,
+   * with a Bloom filter of bits_per_entry bits per entry and the layout
+   * filter_type.
+   */
+  BSSTBuilder(const std::string &filename, int64_t max_entries,
+              int64_t bits_per_entry, int64_t filter_type);
+
+  /**
+   * Add a pair. Keys must be added in ascending order.
+   */
+  void add(int64_t key, int64_t value);
+
+  /**
+   * Write the internal pages, the Bloom filter, the leaf summaries and the
+   * metadata page, and close the file. At least one pair must be added.
+   */
+  void finish();
+};
+
+#endif  // BSST_BUILDER_HH_
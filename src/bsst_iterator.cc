@@ -0,0 +1,250 @@
+#include "bsst_iterator.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+BSSTIterator::BSSTIterator(Database &db, TableReader &reader, AccessHint hint,
+                           int64_t lower_bound, int64_t upper_bound,
+                           size_t prefetch_pages)
+    : db(db),
+      reader(reader),
+      hint(hint),
+      leaves_begin(reader.metadata.entries_offset),
+      // Leaves end where the Bloom filter starts
+      leaves_end(reader.metadata.filter_offset),
+      lower_bound(lower_bound),
+      upper_bound(upper_bound),
+      prefetch_pages(max<size_t>(prefetch_pages, 1)),
+      batch_pages(1),
+      window_pos(0),
+      next_offset(0),
+      prev_offset(0),
+      index(0),
+      forward(true),
+      valid(false) {}
+
+bool BSSTIterator::refill() {
+  window.clear();
+  if (forward) {
+    while (window.size() < batch_pages && next_offset < leaves_end) {
+      window.push_back(PageRequest{&reader, next_offset, PageHandle()});
+      next_offset += PAGE_SIZE;
+    }
+  } else {
+    // Take the leaves just before prev_offset, still read in file order
+    size_t count = min<size_t>(batch_pages,
+                               (prev_offset - leaves_begin) / PAGE_SIZE);
+    prev_offset -= count * PAGE_SIZE;
+    for (size_t i = 0; i < count; i++) {
+      window.push_back(
+          PageRequest{&reader, prev_offset + (int64_t)i * PAGE_SIZE,
+                      PageHandle()});
+    }
+  }
+  if (window.empty()) {
+    return false;
+  }
+  window_pos = forward ? 0 : window.size() - 1;
+  db.find_pages(window, hint);
+  batch_pages = min(batch_pages * 2, prefetch_pages);
+  return true;
+}
+
+void BSSTIterator::next_leaf() {
+  // Unpin the leaf that is done
+  window[window_pos].page.release();
+  if (forward) {
+    index = 0;
+    if (window_pos + 1 < window.size()) {
+      window_pos++;
+      return;
+    }
+  } else {
+    index = PAGE_NUM_ENTRIES - 1;
+    if (window_pos > 0) {
+      window_pos--;
+      return;
+    }
+  }
+  if (!refill()) {
+    valid = false;
+  }
+}
+
+void BSSTIterator::settle() {
+  while (valid && forward) {
+    if (index >= PAGE_NUM_ENTRIES || window[window_pos].page[index].key == 0) {
+      // The rest of the leaf is padding
+      next_leaf();
+      continue;
+    }
+    if (window[window_pos].page[index].key > upper_bound) {
+      valid = false;
+    }
+    return;
+  }
+  while (valid && !forward) {
+    if (index < 0) {
+      next_leaf();
+      continue;
+    }
+    if (window[window_pos].page[index].key == 0) {
+      // Padding at the end of the leaf
+      index--;
+      continue;
+    }
+    if (window[window_pos].page[index].key < lower_bound) {
+      valid = false;
+    }
+    return;
+  }
+}
+
+void BSSTIterator::SeekToFirst() {
+  forward = true;
+  next_offset = leaves_begin;
+  batch_pages = 1;
+  index = 0;
+  valid = refill();
+  settle();
+}
+
+void BSSTIterator::Seek(int64_t key) {
+  // No entry has key 0, it is reserved for padding
+  if (key == 0) {
+    key = 1;
+  }
+  forward = true;
+  int64_t offset = seek_offset(key);
+  if (offset == -1) {
+    window.clear();
+    valid = false;
+    return;
+  }
+  next_offset = offset;
+  batch_pages = 1;
+  valid = refill();
+  if (!valid) {
+    return;
+  }
+  // Binary search the first entry >= key in the leaf, padding sorts last
+  const PageHandle &page = window[window_pos].page;
+  int left = 0;
+  int right = PAGE_NUM_ENTRIES;
+  while (left < right) {
+    int mid = left + (right - left) / 2;
+    if (page[mid].key != 0 && page[mid].key < key) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  index = left;
+  settle();
+}
+
+void BSSTIterator::SeekToLast() {
+  forward = false;
+  // Round up like the forward walk, which reads a last partial page too
+  prev_offset = leaves_begin + (leaves_end - leaves_begin + PAGE_SIZE - 1) /
+                                   PAGE_SIZE * PAGE_SIZE;
+  batch_pages = 1;
+  index = PAGE_NUM_ENTRIES - 1;
+  valid = refill();
+  settle();
+}
+
+void BSSTIterator::SeekForPrev(int64_t key) {
+  // No entry has key 0, it is reserved for padding
+  if (key == 0) {
+    key = -1;
+  }
+  int64_t offset = seek_offset(key);
+  if (offset == -1) {
+    // Every key of the SST is smaller
+    SeekToLast();
+    return;
+  }
+  forward = false;
+  prev_offset = offset + PAGE_SIZE;
+  batch_pages = 1;
+  valid = refill();
+  if (!valid) {
+    return;
+  }
+  // Binary search the first entry > key in the leaf, the entry before it is
+  // the last one <= key. If there is none, settle moves to the previous leaf
+  const PageHandle &page = window[window_pos].page;
+  int left = 0;
+  int right = PAGE_NUM_ENTRIES;
+  while (left < right) {
+    int mid = left + (right - left) / 2;
+    if (page[mid].key != 0 && page[mid].key <= key) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  index = left - 1;
+  settle();
+}
+
+int64_t BSSTIterator::seek_offset(int64_t key) {
+  // -1 means either key is zero (reserved for padding) or key is larger than
+  // any key in the SST
+  return db.getScanOffset(key, reader);
+}
+
+void BSSTIterator::Next() {
+  if (!forward) {
+    Seek(key() + 1);
+    return;
+  }
+  index++;
+  settle();
+}
+
+void BSSTIterator::Prev() {
+  if (forward) {
+    SeekForPrev(key() - 1);
+    return;
+  }
+  index--;
+  settle();
+}
+
+const KeyValuePair &BSSTIterator::entry() const {
+  return window[window_pos].page[index];
+}
+
+SortedSSTIterator::SortedSSTIterator(Database &db, TableReader &reader,
+                                     AccessHint hint, int64_t lower_bound,
+                                     int64_t upper_bound,
+                                     size_t prefetch_pages)
+    : BSSTIterator(db, reader, hint, lower_bound, upper_bound,
+                   prefetch_pages) {
+  leaves_begin = 0;
+  leaves_end = reader.file_size;
+}
+
+int64_t SortedSSTIterator::seek_offset(int64_t key) {
+  // Find the first page whose last key is >= key
+  int64_t left = 0;
+  int64_t right = leaves_end / PAGE_SIZE;
+  while (left < right) {
+    int64_t mid = left + (right - left) / 2;
+    PageHandle page = db.read_page(reader, mid * PAGE_SIZE, hint);
+    // Padding (key 0) only follows the last entry of the SST
+    int last = PAGE_NUM_ENTRIES - 1;
+    while (last > 0 && page[last].key == 0) {
+      last--;
+    }
+    if (page[last].key < key) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left * PAGE_SIZE < leaves_end ? left * PAGE_SIZE : -1;
+}
@@ -0,0 +1,110 @@
+#ifndef BSST_ITERATOR_HH_
+#define BSST_ITERATOR_HH_
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "constants.hh"
+#include "database.hh"
+#include "iterator.hh"
+
+class BSSTIterator : public Iterator {
+  /**
+   * Walks the leaves of a B-tree SST in key order, reading them through the
+   * database with the given access hint. Leaves are laid out one after the
+   * other, so they can be walked backwards as well. The iterator stops at the
+   * first key past the lower or upper bound in the direction it moves, so a
+   * narrow scan only reads the leaves it needs.
+   *
+   * Leaves are read ahead in batches, submitted together when asynchronous
+   * I/O is enabled. A batch starts at one page and doubles on every refill,
+   * up to prefetch_pages, so short scans do not read leaves they will not
+   * use while long scans and compactions keep many reads in flight.
+   */
+ protected:
+  Database &db;
+  TableReader &reader;
+  AccessHint hint;
+  int64_t leaves_begin;   // offset of the first leaf
+  int64_t leaves_end;     // offset after the last leaf
+  int64_t lower_bound;    // smallest key returned
+  int64_t upper_bound;    // largest key returned
+  size_t prefetch_pages;  // largest number of leaves read at once
+  size_t batch_pages;     // number of leaves read by the next refill
+  std::vector<PageRequest> window;  // leaves read ahead, in file order
+  size_t window_pos;      // index of the current leaf in window
+  int64_t next_offset;    // offset of the first leaf not read yet
+  int64_t prev_offset;    // offset after the last leaf not read yet
+  int index;              // index of the current entry in the leaf
+  bool forward;           // true if moving towards larger keys
+  bool valid;
+
+  /**
+   * Return the offset of the leaf where key may reside in, or -1 if every
+   * key of the SST is smaller.
+   */
+  virtual int64_t seek_offset(int64_t key);
+
+  /**
+   * Read the next batch of leaves in the direction of iteration into window.
+   * Return false if there are no leaves left.
+   */
+  bool refill();
+
+  /**
+   * Make the first entry of the next leaf in the direction of iteration (the
+   * last entry going backwards) current, or invalidate the iterator if there
+   * is none.
+   */
+  void next_leaf();
+
+  /**
+   * Skip padding at the end of the current leaf and check the bound in the
+   * direction of iteration.
+   */
+  void settle();
+
+ public:
+  BSSTIterator(Database &db, TableReader &reader, AccessHint hint,
+               int64_t lower_bound = std::numeric_limits<int64_t>::min(),
+               int64_t upper_bound = std::numeric_limits<int64_t>::max(),
+               size_t prefetch_pages = LEAF_PREFETCH_PAGES);
+
+  BSSTIterator(const BSSTIterator &) = delete;
+  BSSTIterator &operator=(const BSSTIterator &) = delete;
+
+  void SeekToFirst() override;
+  void Seek(int64_t key) override;
+  void SeekToLast() override;
+  void SeekForPrev(int64_t key) override;
+  bool Valid() const override { return valid; }
+  void Next() override;
+  void Prev() override;
+
+  /**
+   * Return the current entry. The iterator must be valid.
+   */
+  const KeyValuePair &entry() const;
+
+  int64_t key() const override { return entry().key; }
+
+  int64_t value() const override { return entry().value; }
+};
+
+class SortedSSTIterator : public BSSTIterator {
+  /**
+   * Walks a sorted SST, which is made of leaves only. Seek binary searches
+   * the pages instead of descending a B-tree.
+   */
+ protected:
+  int64_t seek_offset(int64_t key) override;
+
+ public:
+  SortedSSTIterator(Database &db, TableReader &reader, AccessHint hint,
+                    int64_t lower_bound = std::numeric_limits<int64_t>::min(),
+                    int64_t upper_bound = std::numeric_limits<int64_t>::max(),
+                    size_t prefetch_pages = LEAF_PREFETCH_PAGES);
+};
+
+#endif  // BSST_ITERATOR_HH_
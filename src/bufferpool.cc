@@ -1,126 +1,424 @@
 #include "bufferpool.hh"
 
 #include <cmath>
+#include <cstring>
 #include <iostream>
 #include <memory>
-#include <optional>
-
-#include "MurmurHash3.hh"
+#include <stdexcept>
 
 using namespace std;
 
-Bufferpool::Bufferpool(size_t size) : capacity(size), num_pages(0) {
-  num_buckets = nearest_power_of_2(capacity);
-  table.resize(num_buckets);
+Bufferpool::Bufferpool(size_t size, const string &policy_name,
+                       size_t num_shards)
+    : shards(max<size_t>(num_shards, 1)),
+      capacity(size),
+      policy_name(policy_name) {
+  for (size_t i = 0; i < shards.size(); i++) {
+    shards[i].reset(
+        new BufferpoolShard(shard_capacity(capacity, i), policy_name));
+  }
 }
 
 Bufferpool::~Bufferpool() {}
 
-size_t Bufferpool::nearest_power_of_2(size_t N) {
+BufferpoolShard::BufferpoolShard(size_t size, const string &policy_name)
+    : policy_name(policy_name), capacity(size), num_pages(0) {
+  allocate(capacity);
+}
+
+PageHandle::PageHandle(PageHandle &&other)
+    : pool(other.pool),
+      frame(other.frame),
+      owned(other.owned),
+      page(other.page) {
+  other.pool = nullptr;
+  other.frame = nullptr;
+  other.owned = nullptr;
+  other.page = nullptr;
+}
+
+PageHandle &PageHandle::operator=(PageHandle &&other) {
+  if (this != &other) {
+    release();
+    pool = other.pool;
+    frame = other.frame;
+    owned = other.owned;
+    page = other.page;
+    other.pool = nullptr;
+    other.frame = nullptr;
+    other.owned = nullptr;
+    other.page = nullptr;
+  }
+  return *this;
+}
+
+void PageHandle::release() {
+  if (frame) {
+    pool->unpin(frame);
+  }
+  if (owned) {
+    PageAllocator::free_page(owned);
+  }
+  pool = nullptr;
+  frame = nullptr;
+  owned = nullptr;
+  page = nullptr;
+}
+
+PageHandle PageHandle::allocate_owned(KeyValuePair *&page_data) {
+  PageHandle handle;
+  handle.owned = PageAllocator::allocate_page();
+  handle.page = handle.owned;
+  page_data = handle.owned;
+  return handle;
+}
+
+void PageHandle::finish_load() {
+  if (frame) {
+    pool->finish_load(frame);
+  }
+}
+
+BufferpoolShard &Bufferpool::shard_of(PageId page_id) {
+  if (shards.size() == 1) {
+    return *shards[0];
+  }
+  // Use other bits of the hash than the frame table of the shard does
+  uint64_t hash_otpt = page_id * 0xC2B2AE3D27D4EB4FULL;
+  return *shards[(hash_otpt >> 40) % shards.size()];
+}
+
+size_t Bufferpool::shard_capacity(size_t capacity, size_t shard) {
+  // Split the pages evenly, the first shards take the remainder
+  return capacity / shards.size() +
+         (shard < capacity % shards.size() ? 1 : 0);
+}
+
+void BufferpoolShard::allocate(size_t new_capacity) {
+  // Frames are aligned to PAGE_SIZE so pages can be read into them with
+  // O_DIRECT
+  pages = PageAllocator::allocate_pages(new_capacity);
+  frames.assign(new_capacity, Frame());
+  free_frames.clear();
+  // Hand out low frames first
+  for (size_t i = new_capacity; i-- > 0;) {
+    frames[i].data = pages.get() + i * PAGE_NUM_ENTRIES;
+    free_frames.push_back(i);
+  }
+  // Keep the table at most half full so probe sequences stay short
+  num_buckets = nearest_power_of_2(max<size_t>(2 * new_capacity, 1));
+  table.assign(num_buckets, FrameSlot{INVALID_PAGE_ID, 0});
+  policy = EvictionPolicy::create(policy_name, new_capacity);
+  num_pages = 0;
+}
+
+size_t BufferpoolShard::nearest_power_of_2(size_t N) {
   size_t a = log2(N);
   if (pow(2, a) == N) return N;
   return pow(2, a + 1);
 }
 
-void Bufferpool::evict() {
-  string page_id = queue.remove_head();
-  if (page_id != "") {
-    // Remove corresponding frame in the table
-    remove(page_id);
-    return;
+bool BufferpoolShard::evict() {
+  if (num_pages == 0) {
+    // Somethings is wrong
+    std::cerr << "Fatal: try to evict from an empty bufferpool." << std::endl;
+    exit(EXIT_FAILURE);
   }
-  // Somethings is wrong
-  std::cerr << "Fatal: try to remove lruNode that DNE." << std::endl;
-  exit(EXIT_FAILURE);
+  // Pinned pages are being read, skip them
+  size_t victim = policy->evict(
+      [this](size_t frame) { return frames[frame].pin_count > 0; });
+  if (victim == LRU_NIL) {
+    return false;
+  }
+  // Remove corresponding frame in the table
+  size_t slot;
+  find_slot(frames[victim].page_id, slot);
+  release_slot(slot);
+  return true;
 }
 
 void Bufferpool::resize(size_t new_capacity) {
+  capacity = new_capacity;
+  for (size_t i = 0; i < shards.size(); i++) {
+    shards[i]->resize(shard_capacity(capacity, i));
+  }
+}
+
+void Bufferpool::set_num_shards(size_t num_shards) {
+  // Check every shard before dropping any, so a pinned page leaves the
+  // bufferpool as it was
+  for (auto &shard : shards) {
+    if (shard->has_pinned_pages()) {
+      throw runtime_error(
+          "Bufferpool::set_num_shards called with pinned pages");
+    }
+  }
+  shards.clear();
+  shards.resize(max<size_t>(num_shards, 1));
+  for (size_t i = 0; i < shards.size(); i++) {
+    shards[i].reset(
+        new BufferpoolShard(shard_capacity(capacity, i), policy_name));
+  }
+}
+
+bool BufferpoolShard::has_pinned_pages() {
+  lock_guard<mutex> guard(latch);
+  for (auto &frame : frames) {
+    if (frame.pin_count > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void BufferpoolShard::resize(size_t new_capacity) {
+  lock_guard<mutex> guard(latch);
+  for (auto &frame : frames) {
+    if (frame.pin_count > 0) {
+      throw runtime_error("Bufferpool::resize called with pinned pages");
+    }
+  }
   capacity = new_capacity;
   while (new_capacity < num_pages && num_pages != 0) {
     evict();
   }
-  // Want to shrink buckets if there are large overheads
-  size_t num_bucket_candidate = nearest_power_of_2(new_capacity);
-  if (num_bucket_candidate < num_buckets) {
-    num_buckets = num_bucket_candidate;
-    // Rehash everything and put into new table
-    vector<unique_ptr<Bucket>> new_table(num_buckets);
-    for (auto &head : table) {
-      while (head) {
-        // Extract the node from the old table
-        unique_ptr<Bucket> old_head = std::move(head);
-        // Advance the head to the next node
-        head = std::move(old_head->next);
-        // Compute the new index for the old head
-        uint32_t index = get_key(old_head->page_id);
-        // Insert the node into the new table
-        old_head->next = std::move(new_table[index]);
-        new_table[index] = std::move(old_head);
-      }
-    }
-    table = std::move(new_table);
+  // Move the remaining pages to a page array of the new size, in the order
+  // the policy would evict them so that order is kept
+  vector<PageId> page_ids;
+  vector<KeyValuePair> resident;
+  auto never_pinned = [](size_t) { return false; };
+  for (size_t node = policy->evict(never_pinned); node != LRU_NIL;
+       node = policy->evict(never_pinned)) {
+    page_ids.push_back(frames[node].page_id);
+    resident.insert(resident.end(), frames[node].data,
+                    frames[node].data + PAGE_NUM_ENTRIES);
+  }
+  allocate(new_capacity);
+  for (size_t i = 0; i < page_ids.size(); i++) {
+    Frame *frame = claim_frame(page_ids[i]);
+    memcpy(frame->data, resident.data() + i * PAGE_NUM_ENTRIES, PAGE_SIZE);
   }
 }
 
-void Bufferpool::insert(const std::string &page_id,
-                        vector<KeyValuePair> &value) {
+Frame *BufferpoolShard::claim_frame(PageId page_id, AccessHint hint) {
+  Frame *existing = find(page_id);
+  if (existing) {
+    if (hint == POINT_ACCESS) {
+      policy->access(existing - frames.data());
+    }
+    return existing;
+  }
   if (capacity == 0) {
-    return;
+    return nullptr;
   }
-  // If bufferpool is full
-  if (capacity == num_pages) {
-    evict();
+  // If bufferpool is full and every page is pinned, do not cache the page
+  if (capacity <= num_pages && !evict()) {
+    return nullptr;
   }
-  uint32_t index = get_key(page_id);
-  unique_ptr<Bucket> newBucket(new Bucket(page_id, value));
-  newBucket->next = std::move(table[index]);
+  size_t index = free_frames.back();
+  free_frames.pop_back();
+  Frame &frame = frames[index];
+  frame.page_id = page_id;
 
-  // Put into LRU queue
-  shared_ptr<LRUNode> node = make_shared<LRUNode>(LRUNode(page_id));
-  queue.put(node);
-  newBucket->lruNode = node;
+  policy->insert(index, page_id, hint);
 
-  table[index] = std::move(newBucket);
+  size_t slot = get_key(page_id);
+  while (table[slot].page_id != INVALID_PAGE_ID) {
+    slot = (slot + 1) & (num_buckets - 1);
+  }
+  table[slot] = FrameSlot{page_id, index};
   num_pages++;
+  return &frame;
 }
 
-bool Bufferpool::remove(const std::string &page_id) {
-  uint32_t index = get_key(page_id);
-  Bucket *prev = nullptr, *head = table[index].get();
-  while (head != nullptr) {
-    if (head->page_id == page_id) {
-      queue.remove_node(head->lruNode);
-      if (prev)
-        prev->next = std::move(head->next);
-      else
-        table[index] = std::move(head->next);
-      // Memory are automatically released
-      num_pages--;
-      return true;
+void Bufferpool::insert(PageId page_id, vector<KeyValuePair> &value) {
+  shard_of(page_id).insert(page_id, value);
+}
+
+void BufferpoolShard::insert(PageId page_id, vector<KeyValuePair> &value) {
+  lock_guard<mutex> guard(latch);
+  Frame *frame = claim_frame(page_id);
+  if (frame) {
+    memcpy(frame->data, value.data(), PAGE_SIZE);
+  }
+}
+
+PageHandle Bufferpool::insert(PageId page_id, vector<KeyValuePair> &&page) {
+  KeyValuePair *page_data;
+  PageHandle handle = allocate_page(page_id, page_data);
+  if (!handle) {
+    handle = PageHandle::allocate_owned(page_data);
+    memcpy(page_data, page.data(), PAGE_SIZE);
+    return handle;
+  }
+  if (page_data) {
+    memcpy(page_data, page.data(), PAGE_SIZE);
+    handle.finish_load();
+  }
+  return handle;
+}
+
+PageHandle Bufferpool::allocate_page(PageId page_id, KeyValuePair *&page_data,
+                                     AccessHint hint) {
+  return shard_of(page_id).allocate_page(page_id, page_data, hint);
+}
+
+PageHandle BufferpoolShard::allocate_page(PageId page_id,
+                                          KeyValuePair *&page_data,
+                                          AccessHint hint) {
+  unique_lock<mutex> lock(latch);
+  page_data = nullptr;
+  Frame *frame = find_loaded(page_id, lock);
+  if (frame) {
+    // The page is already in the shard, e.g. read by another thread
+    if (hint == POINT_ACCESS) {
+      policy->access(frame - frames.data());
+    }
+    frame->pin_count++;
+    return PageHandle(this, frame);
+  }
+  frame = claim_frame(page_id, hint);
+  if (!frame) {
+    return PageHandle();
+  }
+  frame->pin_count++;
+  frame->loading = true;
+  page_data = frame->data;
+  return PageHandle(this, frame);
+}
+
+bool Bufferpool::remove(PageId page_id) {
+  return shard_of(page_id).remove(page_id);
+}
+
+bool BufferpoolShard::remove(PageId page_id) {
+  lock_guard<mutex> guard(latch);
+  size_t slot;
+  if (!find_slot(page_id, slot)) {
+    return false;
+  }
+  if (frames[table[slot].frame].pin_count > 0) {
+    // Still being read, so it stays cached and is left to the eviction
+    // policy like any other page once unpinned
+    return false;
+  }
+  policy->remove(table[slot].frame);
+  release_slot(slot);
+  return true;
+}
+
+bool BufferpoolShard::find_slot(PageId page_id, size_t &slot) {
+  slot = get_key(page_id);
+  while (table[slot].page_id != page_id) {
+    if (table[slot].page_id == INVALID_PAGE_ID) {
+      return false;
+    }
+    slot = (slot + 1) & (num_buckets - 1);
+  }
+  return true;
+}
+
+void BufferpoolShard::release_slot(size_t slot) {
+  frames[table[slot].frame].page_id = INVALID_PAGE_ID;
+  free_frames.push_back(table[slot].frame);
+  num_pages--;
+
+  // Backward shift deletion: move later entries of the probe sequence into
+  // the hole so lookups never stop early
+  size_t hole = slot;
+  table[hole].page_id = INVALID_PAGE_ID;
+  size_t next = hole;
+  while (true) {
+    next = (next + 1) & (num_buckets - 1);
+    if (table[next].page_id == INVALID_PAGE_ID) {
+      break;
+    }
+    size_t home = get_key(table[next].page_id);
+    // The entry stays if its home slot is cyclically in (hole, next]
+    bool stays = hole <= next ? (hole < home && home <= next)
+                              : (hole < home || home <= next);
+    if (!stays) {
+      table[hole] = table[next];
+      table[next].page_id = INVALID_PAGE_ID;
+      hole = next;
     }
-    prev = head;
-    head = (head->next).get();
   }
-  return false;
 }
 
-vector<KeyValuePair> *Bufferpool::search(const std::string &page_id) {
-  uint32_t index = get_key(page_id);
-  Bucket *head = table[index].get();
-  while (head != nullptr) {
-    if (head->page_id == page_id) {
-      // Move to tail of LRU queue for new access.
-      queue.move_to_tail(head->lruNode);
-      return &(head->data);
+Frame *BufferpoolShard::find(PageId page_id) {
+  size_t slot = get_key(page_id);
+  while (table[slot].page_id != INVALID_PAGE_ID) {
+    if (table[slot].page_id == page_id) {
+      return &frames[table[slot].frame];
     }
-    head = (head->next).get();
+    slot = (slot + 1) & (num_buckets - 1);
   }
   return nullptr;
 }
 
-uint32_t Bufferpool::get_key(const std::string &page_id) {
-  uint32_t hash_otpt;
-  MurmurHash3_x86_32(page_id.c_str(), (uint32_t)page_id.size(), SEED,
-                     &hash_otpt);
-  return hash_otpt % num_buckets;
+Frame *BufferpoolShard::find_loaded(PageId page_id, unique_lock<mutex> &lock) {
+  while (true) {
+    Frame *frame = find(page_id);
+    if (!frame || !frame->loading) {
+      return frame;
+    }
+    // The page may be evicted once loaded and unpinned, so look it up again
+    loaded.wait(lock);
+  }
+}
+
+const KeyValuePair *Bufferpool::search(PageId page_id) {
+  return shard_of(page_id).search(page_id);
+}
+
+const KeyValuePair *BufferpoolShard::search(PageId page_id) {
+  unique_lock<mutex> lock(latch);
+  Frame *frame = find_loaded(page_id, lock);
+  if (!frame) {
+    return nullptr;
+  }
+  // Tell the eviction policy about the new access
+  policy->access(frame - frames.data());
+  return frame->data;
+}
+
+PageHandle Bufferpool::pin(PageId page_id, AccessHint hint) {
+  return shard_of(page_id).pin(page_id, hint);
+}
+
+PageHandle BufferpoolShard::pin(PageId page_id, AccessHint hint) {
+  unique_lock<mutex> lock(latch);
+  Frame *frame = find_loaded(page_id, lock);
+  if (!frame) {
+    return PageHandle();
+  }
+  // Tell the eviction policy about the new access, scans and compactions
+  // read a page once and do not make it hot
+  if (hint == POINT_ACCESS) {
+    policy->access(frame - frames.data());
+  }
+  frame->pin_count++;
+  return PageHandle(this, frame);
+}
+
+void BufferpoolShard::unpin(Frame *frame) {
+  lock_guard<mutex> guard(latch);
+  if (frame->pin_count > 0) {
+    frame->pin_count--;
+  }
+}
+
+void BufferpoolShard::finish_load(Frame *frame) {
+  {
+    lock_guard<mutex> guard(latch);
+    frame->loading = false;
+  }
+  loaded.notify_all();
+}
+
+uint32_t BufferpoolShard::get_key(PageId page_id) {
+  // Fibonacci hashing, the upper bits of the product mix both file number
+  // and page number
+  uint64_t hash_otpt = page_id * 0x9E3779B97F4A7C15ULL;
+  return (uint32_t)((hash_otpt >> 32) & (num_buckets - 1));
 }
@@ -1,45 +1,173 @@
 #ifndef BUFFERPOOL_H
 #define BUFFERPOOL_H
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
-#include "bufferpoolLRU.hh"
 #include "constants.hh"
+#include "eviction_policy.hh"
 #include "memtable.hh"
+#include "page_allocator.hh"
 
 using namespace std;
+
+/**
+ * @brief Return the ID of page page_number of the file numbered file_number.
+ */
+inline PageId make_page_id(uint32_t file_number, uint32_t page_number) {
+  return ((PageId)file_number << 32) | page_number;
+}
+
+/**
+ * @brief Each Frame holds one page of the bufferpool and its metadata. The
+ * page itself lives in the contiguous page array of the bufferpool.
+ */
+struct Frame {
+  PageId page_id;      // the ID of the page, INVALID_PAGE_ID if free
+  KeyValuePair *data;  // the data in page, contains 256 entires
+  int pin_count;       // number of PageHandles reading the page
+  bool loading;        // true until the page has been read into data
+
+  Frame()
+      : page_id(INVALID_PAGE_ID), data(nullptr), pin_count(0), loading(false) {}
+};
+
+/**
+ * @brief Slot of the open-addressing frame table. The page ID is kept next
+ * to the frame index so probing never has to touch the frames.
+ */
+struct FrameSlot {
+  PageId page_id;  // ID of the page in frame, INVALID_PAGE_ID if empty
+  size_t frame;    // index of the frame in BufferpoolShard::frames
+};
+
+class BufferpoolShard;
+
 /**
- * @brief Each Bucket(Frame) contains page and the metadata
+ * @brief Read-only reference to a page.
+ *
+ * The page is either a frame of the bufferpool, pinned for as long as the
+ * handle holds it so it cannot be evicted, a page of a memory-mapped SST, or
+ * an aligned page from PageAllocator owned by the handle itself (e.g. when
+ * the bufferpool is disabled).
+ * The page is released when the handle is destroyed or reassigned. Handles
+ * can be moved but not copied.
  */
-struct Bucket {
-  const string page_id;         // the ID of the page
-  vector<KeyValuePair> data;    // the data in page, contains 256 entires
-  unique_ptr<Bucket> next;      // next node in the bucket, if there is any
-  shared_ptr<LRUNode> lruNode;  // lruNode of the page
+class PageHandle {
+  BufferpoolShard *pool;       // shard of frame, if the page is a frame
+  Frame *frame;                // pinned frame, if any
+  KeyValuePair *owned;         // page owned by the handle, if any
+  const KeyValuePair *page;    // entries of the page, null if empty
+
+ public:
+  PageHandle()
+      : pool(nullptr), frame(nullptr), owned(nullptr), page(nullptr) {}
+
   /**
-   * @brief Construct a new Bucket
-   *
-   * @param page_id the ID of the page, consisting file name and page offset
-   * @param data the data in page
+   * @brief Handle on a frame of pool. The frame must already be pinned.
    */
-  Bucket(const string &page_id, const vector<KeyValuePair> &data)
-      : page_id(page_id), data(data), next(nullptr), lruNode(nullptr) {}
+  PageHandle(BufferpoolShard *pool, Frame *frame)
+      : pool(pool), frame(frame), owned(nullptr), page(frame->data) {}
+
+  /**
+   * @brief Handle on a page owned by someone else, e.g. a mapped SST.
+   */
+  explicit PageHandle(const KeyValuePair *view)
+      : pool(nullptr), frame(nullptr), owned(nullptr), page(view) {}
+
+  /**
+   * @brief Return a handle that owns a new aligned page, with page_data
+   * pointing to it so the page can be read into it.
+   */
+  static PageHandle allocate_owned(KeyValuePair *&page_data);
+
+  PageHandle(PageHandle &&other);
+  PageHandle &operator=(PageHandle &&other);
+  ~PageHandle() { release(); }
+
+  PageHandle(const PageHandle &) = delete;
+  PageHandle &operator=(const PageHandle &) = delete;
+
+  /**
+   * Unpin the frame or free the page held by the handle, leaving it empty.
+   */
+  void release();
+
+  /**
+   * Mark the page of a handle returned by Bufferpool::allocate_page as read,
+   * letting other threads waiting for it pin it.
+   */
+  void finish_load();
+
+  const KeyValuePair *data() const { return page; }
+
+  const KeyValuePair &operator[](size_t i) const { return page[i]; }
+
+  explicit operator bool() const { return page != nullptr; }
 };
 
-class Bufferpool {
+class BufferpoolShard {
+  /**
+   * One partition of the bufferpool, with its own frames, frame table and
+   * eviction state, guarded by its own latch. See Bufferpool for the
+   * meaning of the public methods.
+   */
  private:
-  vector<unique_ptr<Bucket>> table;  // Hash table
-  LRUQueue queue;                    // LRU Queue
-  size_t capacity;                   // Capacity in terms of number of pages
-  size_t num_buckets;                // Number of Buckets
-  size_t num_pages;                  // Current number of pages
+  AlignedPages pages;                 // capacity pages, one after the other
+  vector<Frame> frames;               // one frame per page of pages
+  vector<size_t> free_frames;         // indices of frames holding no page
+  vector<FrameSlot> table;            // Hash table, linear probing
+  string policy_name;                 // Name of the eviction policy
+  unique_ptr<EvictionPolicy> policy;  // Picks the frames to evict
+  size_t capacity;                    // Capacity in terms of number of pages
+  size_t num_buckets;                 // Number of slots in table, a power of 2
+  size_t num_pages;                   // Current number of pages
+  mutex latch;                        // Guards everything above
+  condition_variable loaded;          // Signalled when a frame is loaded
+
+  /**
+   * Evict the page chosen by the eviction policy among those that are not
+   * pinned. Return false if every page is pinned.
+   */
+  bool evict();
+
+  /**
+   * Return the frame of page_id, or null if the page is not in the table.
+   */
+  Frame *find(PageId page_id);
+
+  /**
+   * Return the frame of page_id once no thread is reading the page into it
+   * any more, or null if the page is not in the table. lock holds latch.
+   */
+  Frame *find_loaded(PageId page_id, unique_lock<mutex> &lock);
+
+  /**
+   * Set slot to the slot of page_id in the table. Return false if the page is
+   * not in the table.
+   */
+  bool find_slot(PageId page_id, size_t &slot);
+
+  /**
+   * Free the frame referenced by slot and empty the slot.
+   */
+  void release_slot(size_t slot);
+
+  /**
+   * Take a free frame for page_id, evicting a page if the bufferpool is
+   * full, and add it to the table with the priority given by hint. Return
+   * null if every frame is pinned.
+   */
+  Frame *claim_frame(PageId page_id, AccessHint hint = POINT_ACCESS);
 
   /**
-   * Evict a page from buffer pool.
+   * Allocate the page array, the frames and the table for capacity pages.
+   * The bufferpool must be empty.
    */
-  void evict();
+  void allocate(size_t capacity);
 
   /**
    *  Return a number that is the smallest power of 2 greater than N.
@@ -50,28 +178,111 @@ class Bufferpool {
   /**
    * Return the hash key of given page_id
    */
-  uint32_t get_key(const std::string &page_id);
+  uint32_t get_key(PageId page_id);
 
  public:
-  Bufferpool(size_t size);
+  BufferpoolShard(size_t size, const string &policy_name);
+
+  void insert(PageId page_id, vector<KeyValuePair> &page);
+  PageHandle allocate_page(PageId page_id, KeyValuePair *&page_data,
+                           AccessHint hint);
+  bool remove(PageId page_id);
+  const KeyValuePair *search(PageId page_id);
+  PageHandle pin(PageId page_id, AccessHint hint);
+  void unpin(Frame *frame);
+  /**
+   * Clear the loading flag of frame and wake up the threads waiting for it.
+   */
+  void finish_load(Frame *frame);
+  void resize(size_t new_capacity);
+  /**
+   * Return true if a page of the shard is pinned.
+   */
+  bool has_pinned_pages();
+};
+
+class Bufferpool {
+  /**
+   * The bufferpool is split into shards by the hash of the page ID. Each
+   * shard holds its share of the capacity and is locked on its own, so
+   * threads reading different pages rarely wait for each other.
+   *
+   * The capacity is partitioned, not shared: a full shard evicts its own
+   * pages even while another shard has free frames. Each shard allocates
+   * its aligned frames up front, and borrowing a frame from another shard
+   * would mean holding two latches on a miss. The hash spreads the pages of
+   * every file over all shards, so they fill evenly, and with one shard
+   * the policy sees the whole capacity.
+   */
+  vector<unique_ptr<BufferpoolShard>> shards;
+  size_t capacity;  // Capacity in terms of number of pages, over all shards
+  string policy_name;  // Name of the eviction policy of every shard
+
+  /**
+   * Return the shard of page_id.
+   */
+  BufferpoolShard &shard_of(PageId page_id);
+
+  /**
+   * Return the capacity of shard number shard out of a total of capacity.
+   */
+  size_t shard_capacity(size_t capacity, size_t shard);
+
+ public:
+  /**
+   * Bufferpool of size pages evicting with the policy named policy_name
+   * (LRU_POLICY, CLOCK_POLICY or ARC_POLICY), split into num_shards shards.
+   */
+  Bufferpool(size_t size, const string &policy_name = LRU_POLICY,
+             size_t num_shards = 1);
   ~Bufferpool();  // Destructor
 
-  void insert(const std::string &page_id, vector<KeyValuePair> &page);
+  void insert(PageId page_id, vector<KeyValuePair> &page);
+  /**
+   * Copy page into a new frame and return a handle that pins the frame. If
+   * no frame can be freed because all of them are pinned, the page is not
+   * cached and the handle owns it instead. If page_id is already cached,
+   * the handle pins the cached page.
+   */
+  PageHandle insert(PageId page_id, vector<KeyValuePair> &&page);
+  /**
+   * Take a frame for page_id and return a handle that pins it, with
+   * page_data pointing to the frame so the page can be read straight into
+   * it, after which the handle's finish_load must be called. If the page is
+   * already in the bufferpool, page_data is null and the handle pins the
+   * loaded page. Return an empty handle if every frame is pinned. Pages read
+   * by a SCAN_ACCESS are the first to be evicted.
+   */
+  PageHandle allocate_page(PageId page_id, KeyValuePair *&page_data,
+                           AccessHint hint = POINT_ACCESS);
+  /**
+   * Return false when no such page with page_id exist in buffer pool or the
+   * page is pinned, otherwise return true and remove the page from table.
+   */
+  bool remove(PageId page_id);
   /**
-   * Return false when no such page with page_id exist in buffer pool, otherwise
-   * return true and remove the page from table.
+   * Return the entries of the page of a given page_id if it is in buffer
+   * pool, null otherwise. The page is not pinned.
    */
-  bool remove(const std::string &page_id);
+  const KeyValuePair *search(PageId page_id);
   /**
-   * Return true if found the page of a given page_id in buffer pool, false
-   * otherwise. Point page to the found page.
+   * Return a handle that pins the page of page_id without copying it, or an
+   * empty handle if the page is not in buffer pool. Waits if another thread
+   * is still reading the page. Only a POINT_ACCESS counts as a hit for the
+   * eviction policy.
    */
-  vector<KeyValuePair> *search(const std::string &page_id);
+  PageHandle pin(PageId page_id, AccessHint hint = POINT_ACCESS);
   /**
    * Set new capacity of hash table. If more page are in the table than the new
-   * capacity, evict them.
+   * capacity, evict them. Resident pages move to a new page array, so no page
+   * may be pinned.
    */
   void resize(size_t new_capacity);
+  /**
+   * Split the capacity into num_shards shards, dropping every cached page.
+   * If a page is pinned, throw and leave the bufferpool unchanged.
+   */
+  void set_num_shards(size_t num_shards);
 };
 
-#endif  // BUFFERPOOL_H
\ No newline at end of file
+#endif  // BUFFERPOOL_H
@@ -4,76 +4,86 @@
 
 using namespace std;
 
-void LRUQueue::move_to_tail(shared_ptr<LRUNode> node) {
-  // node MUST in the queue and node MUST not be null
+void LRUQueue::move_to_tail(size_t node) {
+  // node MUST in the queue
   if (tail == node) {
     // the node is already at the tail
     return;
   }
+  LRUNode &links = nodes[node];
   // If the node to move is the head
   if (head == node) {
-    head = node->next;
-    head->prev = nullptr;
+    head = links.next;
+    nodes[head].prev = LRU_NIL;
   } else {
     // Disconnect the node from its current position
-    node->prev->next = node->next;
-    if (node->next) {
-      node->next->prev = node->prev;
+    nodes[links.prev].next = links.next;
+    if (links.next != LRU_NIL) {
+      nodes[links.next].prev = links.prev;
     }
   }
   // Move the node to the tail
-  tail->next = node;
-  node->prev = tail;
-  node->next = nullptr;
+  nodes[tail].next = node;
+  links.prev = tail;
+  links.next = LRU_NIL;
   tail = node;  // Update the tail pointer
 }
 
-void LRUQueue::remove_node(shared_ptr<LRUNode> node) {
-  if (node->next) {
-    node->next->prev = node->prev;
+void LRUQueue::remove_node(size_t node) {
+  LRUNode &links = nodes[node];
+  if (links.next != LRU_NIL) {
+    nodes[links.next].prev = links.prev;
   } else {
     // Node is tail
-    tail = node->prev;
+    tail = links.prev;
   }
-  if (node->prev) {
-    node->prev->next = node->next;
+  if (links.prev != LRU_NIL) {
+    nodes[links.prev].next = links.next;
   } else {
     // Node is head
-    head = node->next;
+    head = links.next;
   }
-  // memory is handled automatically
-  return;
+  links.prev = links.next = LRU_NIL;
 }
 
-string LRUQueue::remove_head() {
-  if (!head) return "";
+size_t LRUQueue::remove_head() {
+  if (head == LRU_NIL) return LRU_NIL;
 
-  if (head->next) head->next->prev = nullptr;
-
-  string page_id = head->page_id;
-  // memory is handled automatically
-  head = head->next;
-  if (!head) tail = nullptr;
-  return page_id;
+  size_t node = head;
+  remove_node(node);
+  return node;
 }
 
 void LRUQueue::print_queue() {
   std::cerr << "[ ";
-  LRUNode *curr = head.get();
-  while (curr) {
-    std::cerr << curr->page_id << " ";
-    curr = curr->next.get();
+  for (size_t curr = head; curr != LRU_NIL; curr = nodes[curr].next) {
+    std::cerr << curr << " ";
   }
   std::cerr << "]" << std::endl;
 }
 
-void LRUQueue::put(shared_ptr<LRUNode> node) {
+void LRUQueue::put(size_t node) {
   // node MUST be DNE in the queue
-  if (!tail) {
+  LRUNode &links = nodes[node];
+  links.prev = tail;
+  links.next = LRU_NIL;
+  if (tail == LRU_NIL) {
     head = tail = node;
   } else {
-    tail->next = node;
-    node->prev = tail;
+    nodes[tail].next = node;
     tail = node;
   }
-}
\ No newline at end of file
+}
+
+void LRUQueue::put_head(size_t node) {
+  // node MUST be DNE in the queue
+  LRUNode &links = nodes[node];
+  links.prev = LRU_NIL;
+  links.next = head;
+  if (head == LRU_NIL) {
+    head = tail = node;
+  } else {
+    nodes[head].prev = node;
+    head = node;
+  }
+}
@@ -1,37 +1,54 @@
 #ifndef LRU_HH_
 #define LRU_HH_
 
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
-#include <memory>
+#include <vector>
 
 using namespace std;
 
+// Index of no node, ends the queue in both directions
+#define LRU_NIL SIZE_MAX
+
 struct LRUNode {
-  const string page_id;            // ID of the page
-  shared_ptr<LRUNode> prev, next;  // Prev node and next node
-  LRUNode(const string &k) : page_id(k), prev(nullptr), next(nullptr) {}
+  size_t prev, next;  // Index of prev node and next node
+  LRUNode() : prev(LRU_NIL), next(LRU_NIL) {}
 };
 
 class LRUQueue {
   /**
    * The bufferpool uses LRU as the eviction policy.
    *
+   * The queue is an intrusive list over a fixed set of nodes, one per frame
+   * of the bufferpool and identified by the index of the frame. Nodes are
+   * linked by index, so nothing is allocated or reference counted when a
+   * page is accessed.
+   *
    * Note that LRU Queue does not record capacity. Its capacity is the
    * same as the bufferpool and bufferpool should call evict when it is full.
    */
-  shared_ptr<LRUNode> head, tail;
+  vector<LRUNode> nodes;
+  size_t head, tail;
 
  public:
-  LRUQueue() : head(nullptr), tail(nullptr) {}
+  explicit LRUQueue(size_t num_nodes = 0)
+      : nodes(num_nodes), head(LRU_NIL), tail(LRU_NIL) {}
+
+  /**
+   * Put node at the tail of the queue.
+   * The node MUST NOT exist in the queue before.
+   */
+  void put(size_t node);
 
   /**
-   * Put a page_id of a page into the queue.
-   * The page MUST NOT exist in the queue before.
+   * Put node at the head of the queue, so it is the next one evicted.
+   * The node MUST NOT exist in the queue before.
    */
-  void put(shared_ptr<LRUNode> node);
+  void put_head(size_t node);
 
   /**
-   * Print page_ids in order from head to tail.
+   * Print nodes in order from head to tail.
    * For testing only.
    */
   void print_queue();
@@ -40,20 +57,30 @@ class LRUQueue {
    * Move node to tail of the queue.
    * The node MUST exists in the queue.
    */
-  void move_to_tail(shared_ptr<LRUNode> node);
+  void move_to_tail(size_t node);
 
   /**
-   * Remove head of the queue (eviction) and return the page_id it points to.
-   * The node MUST exists in the queue.
+   * Remove head of the queue (eviction) and return it, or LRU_NIL if the
+   * queue is empty.
    */
-  string remove_head();
+  size_t remove_head();
 
   /**
    * Remove perticular node of the queue (eviction).
    * Used when the page is invalidated.
    * The node MUST exists in the queue.
    */
-  void remove_node(shared_ptr<LRUNode> node);
+  void remove_node(size_t node);
+
+  /**
+   * Return the head of the queue (least recently used), or LRU_NIL if empty.
+   */
+  size_t get_head() const { return head; }
+
+  /**
+   * Return the node after node towards the tail, or LRU_NIL.
+   */
+  size_t get_next(size_t node) const { return nodes[node].next; }
 };
 
 #endif  // LRU_HH_
\ No newline at end of file
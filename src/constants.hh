@@ -19,6 +19,70 @@
 // Seed for hash function
 #define SEED 1
 
+// 64MB of Bloom filters kept in memory by default
+#define FILTER_CACHE_BUDGET (64 * 1024 * 1024)
+
+// Number of free aligned pages kept for reuse by private page buffers
+#define PAGE_POOL_CAPACITY 256
+
+// Largest number of B-tree leaves read ahead at once by a BSSTIterator
+#define LEAF_PREFETCH_PAGES 16
+
+// Number of KV-pair slots taken by the summary of one B-tree leaf
+#define LEAF_SUMMARY_ENTRIES 3
+
+// Size of the blocks a memtable arena allocates skiplist nodes from, 64KB
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// Tallest skiplist node, enough for 4^12 = 16M entries
+#define SKIPLIST_MAX_HEIGHT 12
+
+// A skiplist node reaches the next level with a probability of 1 in 4
+#define SKIPLIST_BRANCHING 4
+
+// Number of page reads submitted to io_uring at once
+#define ASYNC_QUEUE_DEPTH 64
+
+// Bloom filter layouts, stored in the metadata page of a BSST
+#define STANDARD_BLOOM_FILTER 0
+
+#define BLOCKED_BLOOM_FILTER 1
+
+// Number of 64-bit words in a block of a blocked Bloom filter (one cache line)
+#define BLOOM_BLOCK_WORDS 8
+
+// Allowed SST read modes
+#define DIRECT_IO "direct_io"
+
+#define MMAP_IO "mmap"
+
+// Allowed bufferpool eviction policies
+#define LRU_POLICY "lru"
+
+#define CLOCK_POLICY "clock"
+
+#define ARC_POLICY "arc"
+
+// Allowed memtable types
+#define AVL_MEMTABLE "avl"
+
+#define SKIPLIST_MEMTABLE "skiplist"
+
+// Default number of full memtables that may wait for the background flush
+// before Put stalls
+#define MAX_IMMUTABLE_MEMTABLES 2
+
+// Allowed sync policies of the write-ahead log
+#define WAL_SYNC_ALWAYS "always"
+
+#define WAL_SYNC_INTERVAL "interval"
+
+#define WAL_SYNC_NONE "none"
+
+// Default longest time a write stays unsynced in the write-ahead log with
+// WAL_SYNC_INTERVAL
+#define WAL_SYNC_INTERVAL_MS 100
+
 // Allowed database types
 #define SORTED_SST "sorted_sst"
 
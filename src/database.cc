@@ -5,26 +5,42 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <limits>
 #include <map>
 #include <memory>
-#include <set>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
-#include "btree.hh"
+#include "aggregate_source.hh"
+#include "bsst_iterator.hh"
 #include "constants.hh"
+#include "db_iterator.hh"
 #include "memtable.hh"
+#include "merging_iterator.hh"
 
 using namespace std;
 
 Database::Database(int memtable_size, size_t bufferpool_capacity,
-                   int64_t bits_per_entry)
-    : memtable(memtable_size, bits_per_entry),
-      bufferpool(bufferpool_capacity),
-      database_dir("") {}
+                   int64_t bits_per_entry, const string &read_mode,
+                   const string &eviction_policy,
+                   const string &memtable_type)
+    : memtable(memtable_size, bits_per_entry, memtable_type),
+      bufferpool(bufferpool_capacity, eviction_policy),
+      database_dir(""),
+      read_mode(read_mode) {
+  // Full memtables are flushed by write, once a group of writes is applied
+  memtable.set_flush_when_full(false);
+}
+
+Database::~Database() { stop_flush_thread(); }
 
 void Database::Open(const string &db_name, const string &database_type) {
   database_dir = db_name;
@@ -43,15 +59,83 @@ void Database::Open(const string &db_name, const string &database_type) {
       load_LSM_tree_state(path_to_lsm_data);
 
       // Remove the LSM tree state file after loading its contents
-      if (remove(path_to_lsm_data.c_str()) != 0) {
+      if (remove(path_to_lsm_data.c_str()) != 0 && errno != ENOENT) {
         perror("Error deleting LSM tree state file");
       }
     }
     // Load SSTs into database
     get_ssts_from_db(db_name);
+    if (db_type == LSM_TREE && lsm_tree.empty()) {
+      // The state is only saved by Close
+      rebuild_LSM_tree_state();
+    }
+    remove_partial_flushes();
+    replay_wals();
+  }
+  if (wal_enabled) {
+    open_wal();
+  }
+}
+
+void Database::remove_partial_flushes() {
+  DIR *dir = opendir(database_dir.c_str());
+  if (dir == nullptr) {
+    return;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    string name = entry->d_name;
+    if (name.compare(0, 9, "MEMTABLE_") == 0 &&
+        name.find(".tmp") != string::npos) {
+      string path = database_dir + "/" + name;
+      if (remove(path.c_str()) != 0) {
+        perror("Error deleting partially flushed memtable");
+      }
+    }
+  }
+  closedir(dir);
+}
+
+void Database::replay_wals() {
+  vector<string> logs;
+  DIR *dir = opendir(database_dir.c_str());
+  if (dir == nullptr) {
+    return;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    string name = entry->d_name;
+    if (name.compare(0, 4, "WAL_") == 0 && name.find(".log") != string::npos) {
+      logs.push_back(database_dir + "/" + name);
+    }
+  }
+  closedir(dir);
+  // Logs are named after the time they were started
+  sort(logs.begin(), logs.end());
+
+  for (const auto &log : logs) {
+    for (const auto &pairs : WriteAheadLog::read(log)) {
+      write(pairs.data(), pairs.size());
+    }
+  }
+  if (logs.empty()) {
+    return;
+  }
+  stop_flush_thread();
+  flush_memtable();
+  for (const auto &log : logs) {
+    remove(log.c_str());
   }
 }
 
+void Database::open_wal() {
+  wal.reset(new WriteAheadLog(
+      database_dir + "/WAL_" +
+          to_string(chrono::system_clock::now().time_since_epoch().count()) +
+          ".log",
+      wal_sync_policy, wal_sync_interval_ms));
+}
+
 void Database::get_ssts_from_db(const string &db_name) {
   const string directory = "./" + db_name;
   vector<string> sst_files;
@@ -74,20 +158,70 @@ void Database::get_ssts_from_db(const string &db_name) {
 
   sort(sst_files.begin(), sst_files.end());
   memtable.set_sst_count((int)sst_files.size());
+
+  // Keep the readers of SSTs that are still present, open the new ones.
+  map<string, shared_ptr<TableReader>> open_readers;
+  for (auto &reader : table_readers) {
+    open_readers[reader->path] = reader;
+  }
+  vector<shared_ptr<TableReader>> readers;
+  for (const auto &sst : sst_files) {
+    string path_to_file = db_name + "/" + sst;
+    auto it = open_readers.find(path_to_file);
+    if (it != open_readers.end()) {
+      readers.push_back(it->second);
+      open_readers.erase(it);
+    } else {
+      auto reader = make_shared<TableReader>(
+          path_to_file, sst.substr(0, sst.size() - 4), next_file_number++,
+          read_mode == MMAP_IO);
+      load_table_reader(*reader);
+      readers.push_back(reader);
+    }
+  }
+  for (auto &dropped : open_readers) {
+    unload_table_reader(*dropped.second);
+  }
+
   ssts = sst_files;
+  table_readers = readers;
+}
+
+shared_ptr<TableReader> Database::get_table_reader(const string &file_name) {
+  for (size_t i = 0; i < ssts.size(); i++) {
+    if (ssts[i] == file_name) {
+      return table_readers[i];
+    }
+  }
+  // Not registered yet (e.g. just written by compaction), open it directly.
+  // Only its metadata is needed, the filter is loaded once it is registered.
+  auto reader = make_shared<TableReader>(
+      database_dir + "/" + file_name, file_name.substr(0, file_name.size() - 4),
+      next_file_number++, read_mode == MMAP_IO);
+  reader->metadata = get_btree_metadata(*reader);
+  return reader;
 }
 
-int64_t Database::binary_search(int64_t target_key, int fileSize, int fd,
-                                const string &file_name) {
+void Database::release_table_reader(const string &file_name) {
+  for (size_t i = 0; i < ssts.size(); i++) {
+    if (ssts[i] == file_name) {
+      unload_table_reader(*table_readers[i]);
+      ssts.erase(ssts.begin() + i);
+      table_readers.erase(table_readers.begin() + i);
+      return;
+    }
+  }
+}
+
+int64_t Database::binary_search(int64_t target_key, TableReader &reader) {
   int left = 0;
-  int right = fileSize - PAGE_SIZE;
+  int right = (int)reader.file_size - PAGE_SIZE;
 
-  vector<KeyValuePair> pairs(PAGE_NUM_ENTRIES);
   while (left <= right) {
     int mid = left + (right - left) / 2;
     mid -= mid % PAGE_SIZE;  // Align mid to PAGE_SIZE.
 
-    find_page(fd, pairs, mid, file_name);
+    PageHandle pairs = read_page(reader, mid);
 
     int64_t last_key_read = numeric_limits<int64_t>::min();
     int64_t return_value = -1;
@@ -123,37 +257,38 @@ long Database::get_file_size(const string &file_name) {
   return rc == 0 ? stat_buf.st_size : -1;
 }
 
-int find_effective_size(vector<KeyValuePair> &buffer) {
+int find_effective_size(const KeyValuePair *page) {
   int effective_size = PAGE_NUM_ENTRIES;
-  while (effective_size > 0 && buffer[effective_size - 1].key == 0) {
+  while (effective_size > 0 && page[effective_size - 1].key == 0) {
     --effective_size;
   }
   return effective_size;
 }
 
-int64_t Database::searchBTree(const int64_t &key, int fd, int64_t offset,
-                              int64_t entries_offset,
-                              vector<KeyValuePair> &buffer,
-                              const string &file_name) {
+int64_t Database::searchBTree(const int64_t &key, TableReader &reader) {
   if (key == 0) {
     return -1;
   }
 
+  int64_t entries_offset = reader.metadata.entries_offset;
+  // Metadata is only one page, so the root is after that at offset 4096
+  int64_t offset = PAGE_SIZE;
+
   while (true) {
-    find_page(fd, buffer, offset, file_name);
-    int buffer_effective_size = find_effective_size(buffer);
+    PageHandle page = read_page(reader, offset);
+    int page_effective_size = find_effective_size(page.data());
 
     if (offset >= entries_offset) {
       // Leaf node
       int left = 0;
-      int right = buffer_effective_size - 1;
+      int right = page_effective_size - 1;
 
       while (left <= right) {
         int mid = left + (right - left) / 2;
 
-        if (buffer[mid].key == key) {
-          return buffer[mid].value;  // Key found
-        } else if (buffer[mid].key < key) {
+        if (page[mid].key == key) {
+          return page[mid].value;  // Key found
+        } else if (page[mid].key < key) {
           left = mid + 1;
         } else {
           right = mid - 1;
@@ -164,13 +299,13 @@ int64_t Database::searchBTree(const int64_t &key, int fd, int64_t offset,
     } else {
       // Internal node
       int left = 0;
-      int right = buffer_effective_size - 1;
+      int right = page_effective_size - 1;
       int result_index = -1;
 
       while (left <= right) {
         int mid = left + (right - left) / 2;
 
-        if (buffer[mid].key >= key) {
+        if (page[mid].key >= key) {
           result_index = mid;
           right = mid - 1;
         } else {
@@ -179,8 +314,7 @@ int64_t Database::searchBTree(const int64_t &key, int fd, int64_t offset,
       }
 
       if (result_index != -1) {
-        offset =
-            buffer[result_index].value;  // Update offset for next iteration
+        offset = page[result_index].value;  // Update offset for next iteration
       } else {
         return -1;  // Key not found
       }
@@ -188,35 +322,41 @@ int64_t Database::searchBTree(const int64_t &key, int fd, int64_t offset,
   }
 }
 
-BSSTMetadata Database::get_btree_metadata(int fd, vector<KeyValuePair> &buffer,
-                                          const string &file_name) {
+BSSTMetadata Database::get_btree_metadata(TableReader &reader) {
   // Read page at offset 0
   BSSTMetadata metadata{};
-  find_page(fd, buffer, 0, file_name);
-  metadata.entries_offset = buffer[0].key;
-  metadata.filter_offset = buffer[0].value;
-  metadata.seeds_offset = buffer[1].key;
-  metadata.bits_per_entry = buffer[1].value;
-  metadata.num_entries = buffer[2].key;
-  metadata.filter_length = buffer[2].value;
-  metadata.num_seeds = buffer[3].key;
-  metadata.file_size = buffer[3].value;
+  PageHandle page = read_page(reader, 0);
+  metadata.entries_offset = page[0].key;
+  metadata.filter_offset = page[0].value;
+  metadata.seeds_offset = page[1].key;
+  metadata.bits_per_entry = page[1].value;
+  metadata.num_entries = page[2].key;
+  metadata.filter_length = page[2].value;
+  metadata.num_seeds = page[3].key;
+  metadata.file_size = page[3].value;
+  metadata.min_key = page[4].key;
+  metadata.max_key = page[4].value;
+  metadata.filter_type = page[5].key;
+  metadata.summaries_offset = page[5].value;
+  // Compacted SSTs can hold fewer entries than their filter was sized for
+  metadata.filter_entries =
+      page[6].key != 0 ? page[6].key : metadata.num_entries;
 
   return metadata;
 }
 
-void Database::populate_filter_vector(int fd, vector<int64_t> &filter,
-                                      BSSTMetadata &metadata,
-                                      vector<KeyValuePair> &buffer,
-                                      const string &file_name) {
+void Database::populate_filter_vector(TableReader &reader,
+                                      vector<int64_t> &filter) {
+  const BSSTMetadata &metadata = reader.metadata;
   int64_t filter_offset = metadata.filter_offset;
   int64_t seeds_offset = metadata.seeds_offset;
 
   int filter_size = 0;
 
   while (filter_offset < seeds_offset) {
-    find_page(fd, buffer, filter_offset, file_name);
-    for (auto entry : buffer) {
+    PageHandle page = read_page(reader, filter_offset);
+    for (int i = 0; i < PAGE_NUM_ENTRIES; i++) {
+      const KeyValuePair &entry = page[i];
       if (entry.key == 0) {
         if (filter_size >= metadata.filter_length) {
           break;
@@ -238,18 +378,20 @@ void Database::populate_filter_vector(int fd, vector<int64_t> &filter,
   assert(filter_size == metadata.filter_length);
 }
 
-void Database::populate_seeds_vector(int fd, vector<int64_t> &seeds,
-                                     BSSTMetadata &metadata,
-                                     vector<KeyValuePair> &buffer,
-                                     const string &file_name) {
+void Database::populate_seeds_vector(TableReader &reader,
+                                     vector<int64_t> &seeds) {
+  const BSSTMetadata &metadata = reader.metadata;
   int64_t seeds_offset = metadata.seeds_offset;
-  int64_t file_size = metadata.file_size;
+  // Leaf summaries follow the seeds in SSTs that have them
+  int64_t seeds_end = metadata.summaries_offset != 0 ? metadata.summaries_offset
+                                                     : metadata.file_size;
 
   int seeds_size = 0;
 
-  while (seeds_offset < file_size) {
-    find_page(fd, buffer, seeds_offset, file_name);
-    for (auto entry : buffer) {
+  while (seeds_offset < seeds_end) {
+    PageHandle page = read_page(reader, seeds_offset);
+    for (int i = 0; i < PAGE_NUM_ENTRIES; i++) {
+      const KeyValuePair &entry = page[i];
       if (entry.key == 0) {
         if (seeds_size >= metadata.num_seeds) {
           break;
@@ -271,16 +413,111 @@ void Database::populate_seeds_vector(int fd, vector<int64_t> &seeds,
   assert(seeds_size == metadata.num_seeds);
 }
 
-BloomFilter Database::construct_bloom_filter(int fd, BSSTMetadata &metadata,
-                                             vector<KeyValuePair> &buffer,
-                                             const string &file_name) {
+BloomFilter Database::construct_bloom_filter(TableReader &reader) {
+  const BSSTMetadata &metadata = reader.metadata;
   vector<int64_t> filter;
   vector<int64_t> seeds;
 
-  populate_filter_vector(fd, filter, metadata, buffer, file_name);
-  populate_seeds_vector(fd, seeds, metadata, buffer, file_name);
+  populate_seeds_vector(reader, seeds);
+  if (reader.mapping) {
+    // The filter is contiguous in the SST, probe it straight from the mapping
+    const int64_t *filter_view =
+        reinterpret_cast<const int64_t *>(reader.mapping + metadata.filter_offset);
+    return {filter_view, metadata.filter_length, metadata.filter_entries,
+            metadata.bits_per_entry, seeds, metadata.filter_type};
+  }
+  populate_filter_vector(reader, filter);
+
+  return {filter, metadata.filter_entries, metadata.bits_per_entry, seeds,
+          metadata.filter_type};
+}
+
+void Database::load_table_reader(TableReader &reader) {
+  if (db_type == SORTED_SST) {
+    load_sorted_sst_key_range(reader);
+    return;
+  }
+  reader.metadata = get_btree_metadata(reader);
+  reader.min_key = reader.metadata.min_key;
+  reader.max_key = reader.metadata.max_key;
+
+  if (db_type == LSM_TREE) {
+    BSSTMetadata &metadata = reader.metadata;
+    // A mapped filter lives in the page cache and only costs its seeds
+    size_t filter_bytes =
+        ((reader.mapping ? 0 : metadata.filter_length) + metadata.num_seeds) *
+        INT64_T_SIZE;
+    if (filter_cache_usage + filter_bytes <= filter_cache_budget) {
+      reader.filter.reset(new BloomFilter(construct_bloom_filter(reader)));
+      reader.filter_bytes = filter_bytes;
+      filter_cache_usage += filter_bytes;
+    }
+  }
+}
+
+void Database::load_leaf_summaries(TableReader &reader) {
+  const BSSTMetadata &metadata = reader.metadata;
+  // SSTs written before leaf summaries existed have none
+  if (!reader.leaf_summaries.empty() || metadata.summaries_offset == 0 ||
+      metadata.entries_offset == 0) {
+    return;
+  }
+  size_t num_leaves =
+      (metadata.filter_offset - metadata.entries_offset) / PAGE_SIZE;
+  const size_t summaries_per_page = PAGE_NUM_ENTRIES / LEAF_SUMMARY_ENTRIES;
+  for (size_t i = 0; i < num_leaves; i += summaries_per_page) {
+    PageHandle page =
+        read_page(reader, metadata.summaries_offset + i / summaries_per_page *
+                                                          PAGE_SIZE,
+                  SCAN_ACCESS);
+    for (size_t j = 0; j < summaries_per_page && i + j < num_leaves; j++) {
+      const KeyValuePair *fields = page.data() + j * LEAF_SUMMARY_ENTRIES;
+      reader.leaf_summaries.push_back(
+          LeafSummary{fields[0].key, fields[0].value, fields[1].key,
+                      fields[1].value, fields[2].key, fields[2].value});
+    }
+  }
+}
+
+void Database::load_sorted_sst_key_range(TableReader &reader) {
+  if (reader.file_size < ENTRY_SIZE) {
+    return;
+  }
+  // Sorted SSTs have no metadata page, the first key of the file is the
+  // smallest one and the last non-padding key is the largest one
+  int64_t min_key = read_page(reader, 0)[0].key;
+
+  int64_t last_offset = ((reader.file_size - 1) / PAGE_SIZE) * PAGE_SIZE;
+  int last_entries = (int)min<int64_t>(
+      (reader.file_size - last_offset) / ENTRY_SIZE, PAGE_NUM_ENTRIES);
+  PageHandle page = read_page(reader, last_offset);
+  int64_t max_key = 0;
+  for (int i = last_entries; i-- > 0;) {
+    if (page[i].key != 0) {
+      max_key = page[i].key;
+      break;
+    }
+  }
+
+  if (min_key != 0 && max_key != 0) {
+    reader.min_key = min_key;
+    reader.max_key = max_key;
+  }
+}
+
+void Database::unload_table_reader(TableReader &reader) {
+  filter_cache_usage -= reader.filter_bytes;
+  reader.filter_bytes = 0;
+  reader.filter.reset();
+}
 
-  return {filter, metadata.num_entries, metadata.bits_per_entry, seeds};
+bool Database::filter_includes(TableReader &reader, const int64_t &key) {
+  if (reader.filter) {
+    return reader.filter->includes(key);
+  }
+  // Filter did not fit in the budget, read it from the SST
+  BloomFilter filter = construct_bloom_filter(reader);
+  return filter.includes(key);
 }
 
 int64_t Database::Get(const int64_t &key) {
@@ -289,54 +526,42 @@ int64_t Database::Get(const int64_t &key) {
   }
   // Try getting from memtable first.
   int64_t value = memtable.get(key);
+  // Then the full memtables waiting to be flushed, newest first
+  for (size_t i = immutables.size(); value == -1 && i-- > 0;) {
+    value = immutables[i]->memtable->get(key);
+  }
   if (value != -1) {
     /* If value == 0, the entrie has been deleted(tombstone) */
     if (value == 0) return -1;
     return value;
   }
 
+  // Probe all B-tree SSTs at once when reads can be batched
+  if (async_reader && read_mode == DIRECT_IO &&
+      (db_type == BSST || db_type == LSM_TREE)) {
+    int64_t value = parallelSearchBTrees(key);
+    /* If value == 0, the entrie has been deleted(tombstone) */
+    if (value == 0) return -1;
+    return value;
+  }
+
   // If not in memtable, search SSTs.
-  for (size_t i = ssts.size(); i-- > 0;) {
-    const auto &sst = ssts[i];
-
-    string path_to_file = database_dir + "/" + sst;
-    string file_name = sst.substr(0, sst.size() - 4);
-    
-    int fd = open(path_to_file.c_str(), O_RDONLY | O_DIRECT);
-    if (fd == -1) {
-      perror("Failed to open the file");
-      exit(EXIT_FAILURE);
+  for (size_t i = table_readers.size(); i-- > 0;) {
+    TableReader &reader = *table_readers[i];
+    // Key is outside the key range of the SST, no need to read it
+    if (!reader.overlaps(key, key)) {
+      continue;
     }
-
     int64_t value;
     if (db_type == BSST || db_type == LSM_TREE) {
-      vector<KeyValuePair> buffer(PAGE_NUM_ENTRIES);
-      BSSTMetadata metadata = get_btree_metadata(fd, buffer, file_name);
-      int64_t entries_offset = metadata.entries_offset;
-
-      if (db_type == BSST) {
-        value =
-            searchBTree(key, fd, PAGE_SIZE, entries_offset, buffer, file_name);
+      if (db_type == LSM_TREE && !filter_includes(reader, key)) {
+        // Filter doesn't think key is in the SST
+        value = -1;
       } else {
-        BloomFilter filter =
-            construct_bloom_filter(fd, metadata, buffer, file_name);
-        if (filter.includes(key)) {
-          // Metadata is only one page, so the root is after that at offset 4096
-          value = searchBTree(key, fd, PAGE_SIZE, entries_offset, buffer,
-                              file_name);
-        } else {
-          // Filter doesn't think key is in the SST
-          value = -1;
-        }
+        value = searchBTree(key, reader);
       }
     } else {
-      int file_size = (int)get_file_size(path_to_file);
-      value = binary_search(key, file_size, fd, file_name);
-    }
-
-    if (close(fd) == -1) {
-      perror("Error closing file in Database::Get\n");
-      exit(EXIT_FAILURE);
+      value = binary_search(key, reader);
     }
 
     if (value != -1) {
@@ -348,6 +573,254 @@ int64_t Database::Get(const int64_t &key) {
   return -1;
 }
 
+int64_t Database::parallelSearchBTrees(const int64_t &key) {
+  // SSTs that may hold key, newest first
+  vector<TableReader *> candidates;
+  for (size_t i = table_readers.size(); i-- > 0;) {
+    TableReader &reader = *table_readers[i];
+    if (!reader.overlaps(key, key)) {
+      continue;
+    }
+    if (db_type == LSM_TREE && !filter_includes(reader, key)) {
+      continue;
+    }
+    candidates.push_back(&reader);
+  }
+
+  // Metadata is only one page, so every root is after that at offset 4096
+  vector<int64_t> offsets(candidates.size(), PAGE_SIZE);
+  vector<int64_t> values(candidates.size(), -1);
+  vector<bool> done(candidates.size(), false);
+
+  while (true) {
+    // The newest SST that finished with a value wins once every newer SST
+    // is known not to hold key
+    for (size_t i = 0; i < candidates.size() && done[i]; i++) {
+      if (values[i] != -1) {
+        return values[i];
+      }
+    }
+
+    vector<PageRequest> requests;
+    vector<size_t> active;
+    for (size_t i = 0; i < candidates.size(); i++) {
+      if (!done[i]) {
+        requests.push_back({candidates[i], offsets[i], PageHandle()});
+        active.push_back(i);
+      }
+    }
+    if (active.empty()) {
+      return -1;
+    }
+    find_pages(requests);
+
+    for (size_t r = 0; r < active.size(); r++) {
+      size_t i = active[r];
+      const PageHandle &buffer = requests[r].page;
+      int buffer_effective_size = find_effective_size(buffer.data());
+      int left = 0;
+      int right = buffer_effective_size - 1;
+
+      if (offsets[i] >= candidates[i]->metadata.entries_offset) {
+        // Leaf node
+        while (left <= right) {
+          int mid = left + (right - left) / 2;
+          if (buffer[mid].key == key) {
+            values[i] = buffer[mid].value;
+            break;
+          } else if (buffer[mid].key < key) {
+            left = mid + 1;
+          } else {
+            right = mid - 1;
+          }
+        }
+        done[i] = true;
+      } else {
+        // Internal node
+        int result_index = -1;
+        while (left <= right) {
+          int mid = left + (right - left) / 2;
+          if (buffer[mid].key >= key) {
+            result_index = mid;
+            right = mid - 1;
+          } else {
+            left = mid + 1;
+          }
+        }
+        if (result_index != -1) {
+          offsets[i] = buffer[result_index].value;
+        } else {
+          done[i] = true;
+        }
+      }
+    }
+  }
+}
+
+vector<int64_t> Database::MultiGet(const vector<int64_t> &keys) {
+  vector<int64_t> results(keys.size(), -1);
+
+  // Sort the batch once, duplicate keys are looked up a single time
+  vector<int64_t> sorted_keys;
+  for (auto key : keys) {
+    if (key >= 1) {
+      sorted_keys.push_back(key);
+    }
+  }
+  sort(sorted_keys.begin(), sorted_keys.end());
+  sorted_keys.erase(unique(sorted_keys.begin(), sorted_keys.end()),
+                    sorted_keys.end());
+
+  // Value of every resolved key, 0 for tombstones
+  map<int64_t, int64_t> found;
+  vector<int64_t> pending;
+  for (auto key : sorted_keys) {
+    int64_t value = memtable.get(key);
+    for (size_t i = immutables.size(); value == -1 && i-- > 0;) {
+      value = immutables[i]->memtable->get(key);
+    }
+    if (value != -1) {
+      found[key] = value;
+    } else {
+      pending.push_back(key);
+    }
+  }
+
+  for (size_t i = table_readers.size(); i-- > 0 && !pending.empty();) {
+    TableReader &reader = *table_readers[i];
+
+    // Only probe the keys this SST may hold
+    vector<int64_t> candidates;
+    for (auto key : pending) {
+      if (!reader.overlaps(key, key)) {
+        continue;
+      }
+      if (db_type == LSM_TREE && !filter_includes(reader, key)) {
+        continue;
+      }
+      candidates.push_back(key);
+    }
+    if (candidates.empty()) {
+      continue;
+    }
+
+    vector<int64_t> values(candidates.size(), -1);
+    if (db_type == BSST || db_type == LSM_TREE) {
+      multiSearchBTree(candidates, reader, values);
+    } else {
+      for (size_t j = 0; j < candidates.size(); j++) {
+        values[j] = binary_search(candidates[j], reader);
+      }
+    }
+
+    for (size_t j = 0; j < candidates.size(); j++) {
+      if (values[j] != -1) {
+        found[candidates[j]] = values[j];
+      }
+    }
+    vector<int64_t> still_pending;
+    for (auto key : pending) {
+      if (found.find(key) == found.end()) {
+        still_pending.push_back(key);
+      }
+    }
+    pending = still_pending;
+  }
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    auto it = found.find(keys[i]);
+    /* If value == 0, the entrie has been deleted(tombstone) */
+    if (it != found.end() && it->second != 0) {
+      results[i] = it->second;
+    }
+  }
+  return results;
+}
+
+void Database::multiSearchBTree(const vector<int64_t> &keys,
+                                TableReader &reader, vector<int64_t> &values) {
+  // A node to read and the range [begin, end) of keys that lead to it
+  struct NodeRequest {
+    int64_t offset;
+    size_t begin;
+    size_t end;
+  };
+
+  int64_t entries_offset = reader.metadata.entries_offset;
+  // Metadata is only one page, so the root is after that at offset 4096
+  vector<NodeRequest> level = {{PAGE_SIZE, 0, keys.size()}};
+
+  // Descend the tree one level at a time for the whole batch
+  while (!level.empty()) {
+    vector<NodeRequest> next_level;
+
+    // Read every node of this level at once
+    vector<PageRequest> page_requests;
+    for (size_t i = 0; i < level.size(); i++) {
+      page_requests.push_back({&reader, level[i].offset, PageHandle()});
+    }
+    find_pages(page_requests);
+
+    for (size_t i = 0; i < level.size(); i++) {
+      const NodeRequest &request = level[i];
+      const PageHandle &buffer = page_requests[i].page;
+      int buffer_effective_size = find_effective_size(buffer.data());
+
+      if (request.offset >= entries_offset) {
+        // Leaf node, look up every key of the request in this page
+        for (size_t k = request.begin; k < request.end; k++) {
+          int left = 0;
+          int right = buffer_effective_size - 1;
+          while (left <= right) {
+            int mid = left + (right - left) / 2;
+            if (buffer[mid].key == keys[k]) {
+              values[k] = buffer[mid].value;
+              break;
+            } else if (buffer[mid].key < keys[k]) {
+              left = mid + 1;
+            } else {
+              right = mid - 1;
+            }
+          }
+        }
+        continue;
+      }
+
+      // Internal node, split the keys of the request among the children.
+      // Keys are sorted, so keys that go to the same child are adjacent.
+      size_t k = request.begin;
+      while (k < request.end) {
+        int left = 0;
+        int right = buffer_effective_size - 1;
+        int result_index = -1;
+        while (left <= right) {
+          int mid = left + (right - left) / 2;
+          if (buffer[mid].key >= keys[k]) {
+            result_index = mid;
+            right = mid - 1;
+          } else {
+            left = mid + 1;
+          }
+        }
+        if (result_index == -1) {
+          // This key and all larger ones are beyond the last child
+          break;
+        }
+
+        size_t group_end = k + 1;
+        while (group_end < request.end &&
+               keys[group_end] <= buffer[result_index].key) {
+          group_end++;
+        }
+        next_level.push_back({buffer[result_index].value, k, group_end});
+        k = group_end;
+      }
+    }
+
+    level = next_level;
+  }
+}
+
 void Database::Delete(const int64_t &key) {
   /* We do not call get to double-check if entries exist here */
   Put(key, 0);
@@ -357,20 +830,15 @@ void Database::Update(const int64_t &key, const int64_t &value) {
   Put(key, value);
 }
 
-struct CompareByKey {
-  bool operator()(const KeyValuePair &a, const KeyValuePair &b) const {
-    return a.key < b.key;
-  }
-};
-
-int64_t Database::getScanOffset(const int64_t &key, int fd, int64_t offset,
-                                int64_t entries_offset,
-                                vector<KeyValuePair> &buffer,
-                                const string &file_name) {
+int64_t Database::getScanOffset(const int64_t &key, TableReader &reader) {
   if (key == 0) {
     return -1;
   }
 
+  int64_t entries_offset = reader.metadata.entries_offset;
+  // Metadata is only one page, so the root is after that at offset 4096
+  int64_t offset = PAGE_SIZE;
+
   while (true) {
     if (offset >= entries_offset) {
       // If the offset we are at is beyond entries_offset, then offset is at a
@@ -379,18 +847,18 @@ int64_t Database::getScanOffset(const int64_t &key, int fd, int64_t offset,
       return offset;
     } else {
       // read internal node, meaning its children are other BTreeNodes
-      find_page(fd, buffer, offset, file_name);
-      int buffer_effective_size = find_effective_size(buffer);
+      PageHandle page = read_page(reader, offset);
+      int page_effective_size = find_effective_size(page.data());
 
       // Internal node
       int left = 0;
-      int right = buffer_effective_size - 1;
+      int right = page_effective_size - 1;
       int result_index = -1;
 
       while (left <= right) {
         int mid = left + (right - left) / 2;
 
-        if (buffer[mid].key >= key) {
+        if (page[mid].key >= key) {
           result_index = mid;
           right = mid - 1;
         } else {
@@ -399,7 +867,7 @@ int64_t Database::getScanOffset(const int64_t &key, int fd, int64_t offset,
       }
 
       if (result_index != -1) {
-        int64_t node_offset = buffer[result_index].value;
+        int64_t node_offset = page[result_index].value;
         // Update offset for the next iteration of the loop.
         offset = node_offset;
       } else {
@@ -409,80 +877,160 @@ int64_t Database::getScanOffset(const int64_t &key, int fd, int64_t offset,
   }
 }
 
-void Database::find_page(const int &fd, vector<KeyValuePair> &buffer,
-                         const int64_t &offset, const string &file_name) {
-  string pageId = file_name + "#" + to_string(offset);
+PageHandle Database::find_page(TableReader &reader, const int64_t &offset,
+                               AccessHint hint) {
+  PageId pageId = make_page_id(reader.file_number, offset / PAGE_SIZE);
   /* Search in bufferpool if it is enabled */
   if (bufferpool_enabled) {
-    vector<KeyValuePair> *result = bufferpool.search(pageId);
+    PageHandle result = bufferpool.pin(pageId, hint);
     if (result) {
-      buffer = *result;
-      return;
+      return result;
     }
   }
-  /* If bufferpool disabled or page is not in bufferpool */
-  ssize_t bytes_read = pread(fd, buffer.data(), PAGE_SIZE, offset);
+  /* If bufferpool disabled or page is not in bufferpool, read the page
+   * straight into a frame, or into a page owned by the handle if there is
+   * no frame to read into or the page is compaction input */
+  KeyValuePair *page_data = nullptr;
+  PageHandle page;
+  if (bufferpool_enabled && hint != COMPACTION_ACCESS) {
+    page = bufferpool.allocate_page(pageId, page_data, hint);
+    if (page && !page_data) {
+      // Read by someone else in the meantime
+      return page;
+    }
+  }
+  bool in_frame = (bool)page;
+  if (!in_frame) {
+    page = PageHandle::allocate_owned(page_data);
+  }
+  ssize_t bytes_read = pread(reader.fd, page_data, PAGE_SIZE, offset);
   if (bytes_read <= 0) {
     exit(EXIT_FAILURE);
   }
-  if (bufferpool_enabled) {
-    bufferpool.insert(pageId, buffer);
+  if (bytes_read < PAGE_SIZE) {
+    // The last page of a sorted SST may be partial, and frames and
+    // allocated pages hold the bytes of earlier pages
+    memset(reinterpret_cast<char *>(page_data) + bytes_read, 0,
+           PAGE_SIZE - bytes_read);
+  }
+  if (in_frame) {
+    page.finish_load();
   }
+  return page;
 }
 
-vector<KeyValuePair> Database::b_tree_scan(int64_t key1, int64_t key2,
-                                           int64_t fileSize,
-                                           int64_t entries_offset, int fd,
-                                           const string &file_name) {
-  // Buffer to read in entry pages
-  vector<KeyValuePair> read_buffer(PAGE_NUM_ENTRIES);
-  // Return vector
-  vector<KeyValuePair> entries_in_range;
-  // Get page offset of the page where key1 may reside in
-  int64_t scan_offset = getScanOffset(key1, fd, PAGE_SIZE, entries_offset,
-                                      read_buffer, file_name);
-  // -1 means either key1 is zero (disallowed due to it being reserved for
-  // padding) or key1 is larger than any key in the SST
-  if (scan_offset == -1) {
-    vector<KeyValuePair> empty;
-    return empty;
+PageHandle Database::read_page(TableReader &reader, const int64_t &offset,
+                               AccessHint hint) {
+  if (reader.mapping) {
+    // Read straight from the page cache, no copy and no syscall
+    return PageHandle(
+        reinterpret_cast<const KeyValuePair *>(reader.mapping + offset));
   }
-  // Start scanning pages until end of file
-  while (scan_offset < fileSize) {
-    // Read in page at scan_offset
-    ssize_t bytes_read = pread(fd, read_buffer.data(), PAGE_SIZE, scan_offset);
-    if (bytes_read <= 0) {
-      perror("pread failed");
-      throw runtime_error("pread failed at file: " + file_name +
-                          " offset: " + to_string(scan_offset));
+  return find_page(reader, offset, hint);
+}
+
+void Database::find_pages(vector<PageRequest> &requests, AccessHint hint) {
+  if (!async_reader) {
+    for (auto &request : requests) {
+      request.page = read_page(*request.reader, request.offset, hint);
     }
-    for (int i = 0; i < PAGE_NUM_ENTRIES; ++i) {
-      auto entry = read_buffer[i];
-      if (entry.key >= key1 && entry.key <= key2) {
-        // Entry is in range, push it to the return vector
-        entries_in_range.push_back(entry);
-      } else if (entry.key > key2) {
-        // Entry is beyond key2, meaning all entries after it are also not in
-        // range
-        break;
+    return;
+  }
+
+  vector<PageRead> reads;
+  vector<size_t> read_requests;
+  vector<bool> read_into_frame;  // false for pages owned by the request
+  // Requests for a page that is already being read by an earlier request
+  vector<pair<size_t, size_t>> duplicates;
+  map<PageId, size_t> first_request;
+
+  for (size_t i = 0; i < requests.size(); i++) {
+    PageRequest &request = requests[i];
+    if (request.reader->mapping) {
+      request.page = read_page(*request.reader, request.offset, hint);
+      continue;
+    }
+    PageId pageId =
+        make_page_id(request.reader->file_number, request.offset / PAGE_SIZE);
+    auto it = first_request.find(pageId);
+    if (it != first_request.end()) {
+      duplicates.push_back({i, it->second});
+      continue;
+    }
+    first_request[pageId] = i;
+
+    // Read missing pages straight into frames of the bufferpool
+    KeyValuePair *page_data = nullptr;
+    if (bufferpool_enabled) {
+      request.page = bufferpool.pin(pageId, hint);
+      if (request.page) {
+        continue;
       }
+      if (hint != COMPACTION_ACCESS) {
+        request.page = bufferpool.allocate_page(pageId, page_data, hint);
+        if (request.page && !page_data) {
+          continue;
+        }
+      }
+    }
+    // Pages that could not get a frame are read into an aligned page owned
+    // by the request
+    read_into_frame.push_back((bool)request.page);
+    if (!request.page) {
+      request.page = PageHandle::allocate_owned(page_data);
     }
+    reads.push_back({request.reader->fd, request.offset, page_data, 0});
+    read_requests.push_back(i);
+  }
+
+  async_reader->read_pages(reads);
 
-    // Once all the entries in this page have been processed, increment
-    // scan_offset to read the next page of entries.
-    scan_offset += PAGE_SIZE;
+  for (size_t i = 0; i < reads.size(); i++) {
+    if (reads[i].result <= 0) {
+      exit(EXIT_FAILURE);
+    }
+    if (reads[i].result < PAGE_SIZE) {
+      memset(reinterpret_cast<char *>(reads[i].buffer) + reads[i].result, 0,
+             PAGE_SIZE - reads[i].result);
+    }
+    if (read_into_frame[i]) {
+      requests[read_requests[i]].page.finish_load();
+    }
+  }
+  for (auto &duplicate : duplicates) {
+    // Share the frame of the first request, or copy a page it owns
+    PageRequest &request = requests[duplicate.first];
+    if (bufferpool_enabled) {
+      request.page = bufferpool.pin(
+          make_page_id(request.reader->file_number, request.offset / PAGE_SIZE),
+          hint);
+    }
+    if (!request.page) {
+      KeyValuePair *page_data;
+      request.page = PageHandle::allocate_owned(page_data);
+      memcpy(page_data, requests[duplicate.second].page.data(), PAGE_SIZE);
+    }
+  }
+}
+
+vector<KeyValuePair> Database::b_tree_scan(int64_t key1, int64_t key2,
+                                           TableReader &reader) {
+  // Return vector
+  vector<KeyValuePair> entries_in_range;
+  // Start at the leaf where key1 may reside in and stop at the first key
+  // beyond key2, leaves past it are never read
+  BSSTIterator it(*this, reader, SCAN_ACCESS, key1, key2);
+  for (it.Seek(key1); it.Valid(); it.Next()) {
+    entries_in_range.push_back(it.entry());
   }
   return entries_in_range;
 }
 
 vector<KeyValuePair> Database::binary_search_scan(int64_t key1, int64_t key2,
-                                                  int fileSize, int fd,
-                                                  const string &file_name) {
+                                                  TableReader &reader) {
   int left = 0;
-  int right = fileSize - PAGE_SIZE;
+  int right = (int)reader.file_size - PAGE_SIZE;
 
-  vector<KeyValuePair> pairs(
-      PAGE_NUM_ENTRIES);  // Buffer for one page of key-value pairs
   vector<KeyValuePair> values;
   bool rangeFound = false;
 
@@ -490,12 +1038,7 @@ vector<KeyValuePair> Database::binary_search_scan(int64_t key1, int64_t key2,
     int mid = left + (right - left) / 2;
     mid -= mid % PAGE_SIZE;  // Align mid to PAGE_SIZE.
 
-    ssize_t bytesRead = pread(fd, pairs.data(), PAGE_SIZE, mid);
-    if (bytesRead <= 0) {
-      perror("pread failed");
-      vector<KeyValuePair> empty;
-      return empty;
-    }
+    PageHandle pairs = read_page(reader, mid, SCAN_ACCESS);
 
     int64_t last_key_read = numeric_limits<int64_t>::min();
 
@@ -526,230 +1069,211 @@ vector<KeyValuePair> Database::binary_search_scan(int64_t key1, int64_t key2,
   return values;
 }
 
-ScanResponse Database::Scan(const int64_t &key1, const int64_t &key2) {
-  if (key1 >= key2) {
-    vector<KeyValuePair> empty;
-    ScanResponse emptyScan;
-    emptyScan.result = empty;
-    emptyScan.size = 0;
-    return emptyScan;
+unique_ptr<Iterator> Database::new_range_iterator(int64_t key1, int64_t key2) {
+  // Merge the memtables and the SSTs overlapping the range, newest first, so
+  // newer versions shadow older ones and deleted keys are dropped
+  vector<shared_ptr<Memtable>> memtables;
+  vector<shared_ptr<TableReader>> readers;
+  vector<unique_ptr<Iterator>> sources;
+  sources.emplace_back(new MemtableIterator(memtable));
+  for (size_t i = immutables.size(); i-- > 0;) {
+    memtables.push_back(immutables[i]->memtable);
+    sources.emplace_back(new MemtableIterator(*immutables[i]->memtable));
   }
-
-  set<KeyValuePair, CompareByKey> value_set;
-  vector<KeyValuePair> memtableValues = memtable.scan(key1, key2);
-
-  for (auto memtableValue : memtableValues) {
-    value_set.insert(memtableValue);
-  }
-
-  for (size_t i = ssts.size(); i-- > 0;) {
-    const auto &sst = ssts[i];
-    string path_to_file = database_dir + "/" + sst;
-    string file_name = sst.substr(0, sst.size() - 4);
-
-    int fd = open(path_to_file.c_str(), O_RDONLY | O_DIRECT);
-    if (fd == -1) {
-      perror("Failed to open the file");
-      vector<KeyValuePair> empty;
-      ScanResponse emptyScan;
-      emptyScan.result = empty;
-      emptyScan.size = 0;
-      return emptyScan;
+  for (size_t i = table_readers.size(); i-- > 0;) {
+    TableReader &reader = *table_readers[i];
+    if (!reader.overlaps(key1, key2)) {
+      continue;
     }
-
-    vector<KeyValuePair> sst_values;
-
+    readers.push_back(table_readers[i]);
     if (db_type == SORTED_SST) {
-      int file_size = (int)get_file_size(path_to_file);
-      sst_values = binary_search_scan(key1, key2, file_size, fd, file_name);
+      sources.emplace_back(
+          new SortedSSTIterator(*this, reader, SCAN_ACCESS, key1, key2));
     } else {
-      vector<KeyValuePair> buffer(PAGE_NUM_ENTRIES);
-      BSSTMetadata metadata = get_btree_metadata(fd, buffer, file_name);
-
-      sst_values = b_tree_scan(key1, key2, metadata.filter_offset,
-                               metadata.entries_offset, fd, file_name);
+      sources.emplace_back(
+          new BSSTIterator(*this, reader, SCAN_ACCESS, key1, key2));
     }
+  }
+  return unique_ptr<Iterator>(
+      new DBIterator(std::move(memtables), std::move(readers),
+                     std::move(sources)));
+}
 
-    // Checking each KeyValuePair in sst_values to see if the key is already in
-    // value_set If not, then insert it
-    for (size_t i = 0; i < sst_values.size(); i++) {
-      if (value_set.find(sst_values[i]) == value_set.end()) {
-        value_set.insert(sst_values[i]);
+int64_t Database::Aggregate(const int64_t &key1, const int64_t &key2,
+                            AggregateOp op) {
+  int64_t count = 0, sum = 0, min_value = 0, max_value = 0;
+  // Add num values summing to total, the smallest being low and the largest
+  // high
+  auto add = [&](int64_t num, int64_t total, int64_t low, int64_t high) {
+    min_value = count == 0 ? low : min(min_value, low);
+    max_value = count == 0 ? high : max(max_value, high);
+    count += num;
+    sum += total;
+  };
+
+  if (key1 < key2) {
+    // The memtables, then the SSTs overlapping the range newest first
+    vector<AggregateSource> sources;
+    sources.emplace_back(
+        unique_ptr<Iterator>(new MemtableIterator(memtable)), key1);
+    for (size_t i = immutables.size(); i-- > 0;) {
+      sources.emplace_back(unique_ptr<Iterator>(new MemtableIterator(
+                               *immutables[i]->memtable)),
+                           key1);
+    }
+    for (size_t i = table_readers.size(); i-- > 0;) {
+      TableReader &reader = *table_readers[i];
+      if (!reader.overlaps(key1, key2)) {
+        continue;
+      }
+      if (db_type == SORTED_SST) {
+        sources.emplace_back(
+            unique_ptr<Iterator>(
+                new SortedSSTIterator(*this, reader, SCAN_ACCESS, key1, key2)),
+            key1);
+        continue;
+      }
+      load_leaf_summaries(reader);
+      if (reader.leaf_summaries.empty()) {
+        sources.emplace_back(
+            unique_ptr<Iterator>(
+                new BSSTIterator(*this, reader, SCAN_ACCESS, key1, key2)),
+            key1);
+      } else {
+        sources.emplace_back(*this, reader, key1);
       }
     }
 
-    if (close(fd) == -1) {
-      perror("Error closing file in Database::Get\n");
-      exit(EXIT_FAILURE);
-    }
-  }
+    while (true) {
+      // The source with the smallest key, the newest one on equal keys
+      AggregateSource *next = nullptr;
+      for (auto &source : sources) {
+        if (source.Valid() && (!next || source.key() < next->key())) {
+          next = &source;
+        }
+      }
+      if (!next || next->key() > key2) {
+        break;
+      }
 
-  vector<KeyValuePair> valuesInRange;
-  for (const auto &pair : value_set) {
-    if (pair.value != 0) {
-      valuesInRange.push_back(pair);
+      if (next->at_leaf()) {
+        // A leaf inside the range is counted from its summary if no other
+        // source holds a key of it, as such a key would shadow or be
+        // shadowed by one of the leaf
+        const LeafSummary &leaf = next->summary();
+        bool summarize = leaf.first_key >= key1 && leaf.last_key <= key2;
+        for (auto &source : sources) {
+          if (summarize && &source != next && source.Valid() &&
+              source.key() <= leaf.last_key) {
+            summarize = false;
+          }
+        }
+        if (summarize) {
+          if (leaf.count > 0) {
+            add(leaf.count, leaf.sum, leaf.min, leaf.max);
+          }
+          next->skip_leaf();
+        } else {
+          next->read_leaf();
+        }
+        continue;
+      }
+
+      int64_t key = next->key();
+      int64_t value = next->value();
+      // Move every source past the key, dropping the older versions
+      for (auto &source : sources) {
+        while (source.Valid() && source.key() == key) {
+          if (source.at_leaf()) {
+            source.read_leaf();
+          } else {
+            source.Next();
+          }
+        }
+      }
+      // A value of 0 marks a deleted key
+      if (key >= key1 && value != 0) {
+        add(1, value, value, value);
+      }
     }
   }
-  ScanResponse scanQuery;
-  scanQuery.result = valuesInRange;
-  scanQuery.size = (int)valuesInRange.size();
-  return scanQuery;
-}
-
-string Database::merge_sort_SSTs(const vector<string> &sstsToMerge) {
-  int fd_old = open((database_dir + "/" + sstsToMerge[0]).c_str(), O_RDONLY | O_DIRECT);
-  int fd_new = open((database_dir + "/" + sstsToMerge[1]).c_str(), O_RDONLY | O_DIRECT);
 
-  if (fd_old == -1 || fd_new == -1) {
-    perror("Failed to open SST files");
-    exit(EXIT_FAILURE);
+  switch (op) {
+    case AGGREGATE_COUNT:
+      return count;
+    case AGGREGATE_SUM:
+      return sum;
+    case AGGREGATE_MIN:
+      return count > 0 ? min_value : -1;
+    case AGGREGATE_MAX:
+      return count > 0 ? max_value : -1;
   }
-  vector<KeyValuePair> metadataBufferOld(PAGE_NUM_ENTRIES);
-  vector<KeyValuePair> metadataBufferNew(PAGE_NUM_ENTRIES);
-
-  BSSTMetadata olderSSTMetadata =
-      get_btree_metadata(fd_old, metadataBufferOld, sstsToMerge[0]);
-  BSSTMetadata newerSSTMetadata =
-      get_btree_metadata(fd_new, metadataBufferNew, sstsToMerge[1]);
-
-  string oldfile_name = sstsToMerge[0].substr(0, sstsToMerge[0].size() - 4);
-  string newfile_name = sstsToMerge[1].substr(0, sstsToMerge[1].size() - 4);
-
-  int64_t olderCurrentOffset = olderSSTMetadata.entries_offset;
-  int64_t newerCurrentOffset = newerSSTMetadata.entries_offset;
-
-  // Buffers to store entries
-  vector<KeyValuePair> olderBuffer(PAGE_NUM_ENTRIES);
-  vector<KeyValuePair> newerBuffer(PAGE_NUM_ENTRIES);
-  vector<BTreePair *> mergedEntries;
-
-  // Read the initial pages
-  find_page(fd_old, olderBuffer, olderCurrentOffset, oldfile_name);
-  find_page(fd_new, newerBuffer, newerCurrentOffset, newfile_name);
+  return -1;
+}
 
-  int oldIndex = 0, newIndex = 0;
+unique_ptr<Iterator> Database::NewIterator() {
+  return new_range_iterator(numeric_limits<int64_t>::min(),
+                            numeric_limits<int64_t>::max());
+}
 
-  while (olderCurrentOffset < olderSSTMetadata.filter_offset &&
-         newerCurrentOffset < newerSSTMetadata.filter_offset) {
-    // Perform the merge until one buffer is exhausted
-    while (oldIndex < PAGE_NUM_ENTRIES && newIndex < PAGE_NUM_ENTRIES) {
-      if (olderBuffer[oldIndex].key == 0) {
-        oldIndex = PAGE_NUM_ENTRIES;
-        break;
-      }
-      if (newerBuffer[newIndex].key == 0) {
-        newIndex = PAGE_NUM_ENTRIES;
-        break;
-      }
+ScanResponse Database::Scan(const int64_t &key1, const int64_t &key2) {
+  return Scan(key1, key2, numeric_limits<size_t>::max());
+}
 
-      if (olderBuffer[oldIndex].key == newerBuffer[newIndex].key) {
-        BTreePair *pair = new BTreePair(newerBuffer[newIndex].key,
-                                        newerBuffer[newIndex].value);
-        mergedEntries.push_back(pair);
-        oldIndex += 1;
-        newIndex += 1;
-      } else if (olderBuffer[oldIndex].key < newerBuffer[newIndex].key) {
-        BTreePair *pair = new BTreePair(olderBuffer[oldIndex].key,
-                                        olderBuffer[oldIndex].value);
-        mergedEntries.push_back(pair);
-        oldIndex += 1;
-      } else {  // newer key is less than older key
-        BTreePair *pair = new BTreePair(newerBuffer[newIndex].key,
-                                        newerBuffer[newIndex].value);
-        mergedEntries.push_back(pair);
-        newIndex += 1;
-      }
-    }
-
-    // Read the next page if we've reached the end of one buffer
-    if (oldIndex == PAGE_NUM_ENTRIES &&
-        olderCurrentOffset < olderSSTMetadata.filter_offset) {
-      // remove page from bufferpool if exist
-      if (bufferpool_enabled) {
-        bufferpool.remove(oldfile_name + "#" + to_string(olderCurrentOffset));
-      }
-      olderCurrentOffset += PAGE_SIZE;
-      find_page(fd_old, olderBuffer, olderCurrentOffset, oldfile_name);
-      if (olderCurrentOffset >= olderSSTMetadata.filter_offset) {
-        break;
-      };
-      oldIndex = 0;
-    }
-    if (newIndex == PAGE_NUM_ENTRIES &&
-        newerCurrentOffset < newerSSTMetadata.filter_offset) {
-      // remove page from bufferpool if exist
-      if (bufferpool_enabled) {
-        bufferpool.remove(oldfile_name + "#" + to_string(olderCurrentOffset));
-      }
-      newerCurrentOffset += PAGE_SIZE;
-      find_page(fd_new, newerBuffer, newerCurrentOffset, newfile_name);
-      if (newerCurrentOffset >= newerSSTMetadata.filter_offset) {
-        break;
-      };
-      newIndex = 0;
-    }
+ScanResponse Database::Scan(const int64_t &key1, const int64_t &key2,
+                            size_t limit) {
+  if (key1 >= key2 || limit == 0) {
+    vector<KeyValuePair> empty;
+    ScanResponse emptyScan;
+    emptyScan.result = empty;
+    emptyScan.size = 0;
+    return emptyScan;
   }
 
-  // Fill up the mergedEntries with the rest of the other data.
-  if (oldIndex < PAGE_NUM_ENTRIES) {
-    while (oldIndex < PAGE_NUM_ENTRIES &&
-           olderCurrentOffset < olderSSTMetadata.filter_offset) {
-      if (olderBuffer[oldIndex].key != 0) {
-        BTreePair *pair = new BTreePair(olderBuffer[oldIndex].key,
-                                        olderBuffer[oldIndex].value);
-        mergedEntries.push_back(pair);
-        oldIndex += 1;
-      } else {
-        oldIndex = PAGE_NUM_ENTRIES;
-      }
-
-      if (oldIndex == PAGE_NUM_ENTRIES &&
-          olderCurrentOffset < olderSSTMetadata.filter_offset) {
-        // remove page from bufferpool if exist
-        if (bufferpool_enabled) {
-          bufferpool.remove(oldfile_name + "#" + to_string(olderCurrentOffset));
-        }
-        olderCurrentOffset += PAGE_SIZE;
-        find_page(fd_old, olderBuffer, olderCurrentOffset, oldfile_name);
-        if (olderCurrentOffset >= olderSSTMetadata.filter_offset) {
-          break;
-        };
-        oldIndex = 0;
-      }
+  unique_ptr<Iterator> it = new_range_iterator(key1, key2);
+  vector<KeyValuePair> valuesInRange;
+  for (it->Seek(key1); it->Valid() && it->key() <= key2; it->Next()) {
+    valuesInRange.push_back(KeyValuePair{it->key(), it->value()});
+    if (valuesInRange.size() == limit) {
+      break;
     }
   }
+  ScanResponse scanQuery;
+  scanQuery.result = valuesInRange;
+  scanQuery.size = (int)valuesInRange.size();
+  return scanQuery;
+}
 
-  if (newIndex < PAGE_NUM_ENTRIES) {
-    while (newIndex < PAGE_NUM_ENTRIES &&
-           newerCurrentOffset < newerSSTMetadata.filter_offset) {
-      if (newerBuffer[newIndex].key != 0) {
-        BTreePair *pair = new BTreePair(newerBuffer[newIndex].key,
-                                        newerBuffer[newIndex].value);
-        mergedEntries.push_back(pair);
-        newIndex += 1;
-      } else {
-        newIndex = PAGE_NUM_ENTRIES;
-      }
-
-      if (newIndex == PAGE_NUM_ENTRIES &&
-          newerCurrentOffset < newerSSTMetadata.filter_offset) {
-        // remove page from bufferpool if exist
-        if (bufferpool_enabled) {
-          bufferpool.remove(oldfile_name + "#" + to_string(olderCurrentOffset));
-        }
-        newerCurrentOffset += PAGE_SIZE;
-        find_page(fd_new, newerBuffer, newerCurrentOffset, newfile_name);
-        if (newerCurrentOffset >= newerSSTMetadata.filter_offset) {
-          break;
-        };
-        newIndex = 0;
+ScanResponse Database::ReverseScan(const int64_t &key1, const int64_t &key2,
+                                   size_t limit) {
+  vector<KeyValuePair> valuesInRange;
+  if (key1 < key2 && limit > 0) {
+    unique_ptr<Iterator> it = new_range_iterator(key1, key2);
+    for (it->SeekForPrev(key2); it->Valid() && it->key() >= key1; it->Prev()) {
+      valuesInRange.push_back(KeyValuePair{it->key(), it->value()});
+      if (valuesInRange.size() == limit) {
+        break;
       }
     }
   }
+  ScanResponse scanQuery;
+  scanQuery.result = valuesInRange;
+  scanQuery.size = (int)valuesInRange.size();
+  return scanQuery;
+}
 
-  // Close all file descriptors
-  close(fd_old);
-  close(fd_new);
+string Database::merge_sort_SSTs(const vector<string> &sstsToMerge) {
+  shared_ptr<TableReader> old_reader = get_table_reader(sstsToMerge[0]);
+  shared_ptr<TableReader> new_reader = get_table_reader(sstsToMerge[1]);
+
+  // Compaction input bypasses the bufferpool and is read ahead in batches.
+  // The newer SST wins when both hold the key, and tombstones are kept as
+  // older SSTs may still hold the key
+  vector<unique_ptr<Iterator>> inputs;
+  inputs.emplace_back(new BSSTIterator(*this, *new_reader, COMPACTION_ACCESS));
+  inputs.emplace_back(new BSSTIterator(*this, *old_reader, COMPACTION_ACCESS));
+  MergingIterator merged(std::move(inputs), true);
+  merged.SeekToFirst();
 
   string new_sst_file_name =
       "BSST_" +
@@ -757,9 +1281,19 @@ string Database::merge_sort_SSTs(const vector<string> &sstsToMerge) {
           std::chrono::system_clock::now().time_since_epoch().count()) +
       ".bin";
   string new_sst_path = database_dir + "/" + new_sst_file_name;
+  memtable.CreateCompactedBSST(
+      new_sst_path, merged,
+      old_reader->metadata.num_entries + new_reader->metadata.num_entries);
 
-  memtable.CreateCompactedBSST(new_sst_path, mergedEntries,
-                               mergedEntries.size());
+  // The input SSTs are deleted after the merge, drop their cached pages
+  if (bufferpool_enabled) {
+    for (auto reader : {old_reader, new_reader}) {
+      for (int64_t offset = 0; offset < reader->file_size;
+           offset += PAGE_SIZE) {
+        bufferpool.remove(make_page_id(reader->file_number, offset / PAGE_SIZE));
+      }
+    }
+  }
 
   return new_sst_file_name;
 }
@@ -773,7 +1307,9 @@ void Database::check_LSM_compaction() {
     if (level.second.size() >= 2) {
       // You have two or more SSTs at the same level, perform a merge sort
       string newSSTName = merge_sort_SSTs(level.second);
-      // Delete old SST files
+      // Release the readers of the old SSTs, then delete the files
+      release_table_reader(level.second[0]);
+      release_table_reader(level.second[1]);
       remove((database_dir + "/" + level.second[0]).c_str());
       remove((database_dir + "/" + level.second[1]).c_str());
 
@@ -791,14 +1327,58 @@ void Database::check_LSM_compaction() {
   }
 }
 
-void Database::Put(const int64_t &key, const int64_t &value) {
-  bool sstCreated = memtable.put(key, value);
+void Database::flush_immutables() {
+  unique_lock<mutex> lock(flush_latch);
+  while (true) {
+    // Memtables are written in the order they were queued
+    shared_ptr<ImmutableMemtable> next;
+    for (auto &immutable : immutables) {
+      if (!immutable->flushed) {
+        next = immutable;
+        break;
+      }
+    }
+    if (!next) {
+      if (stop_flushing) {
+        return;
+      }
+      flush_queued.wait(lock);
+      continue;
+    }
+
+    // Write without the latch so Put can queue memtables meanwhile
+    lock.unlock();
+    next->memtable->flush_to(next->path);
+    lock.lock();
+    next->flushed = true;
+    flush_finished.notify_all();
+  }
+}
 
-  if (sstCreated) {
+void Database::install_flushed_memtables() {
+  while (true) {
+    shared_ptr<ImmutableMemtable> oldest;
+    {
+      lock_guard<mutex> guard(flush_latch);
+      if (immutables.empty() || !immutables.front()->flushed) {
+        return;
+      }
+      oldest = immutables.front();
+    }
+
+    if (rename(oldest->path.c_str(), memtable.new_sst_path().c_str()) != 0) {
+      perror("Error installing flushed memtable");
+    }
     get_ssts_from_db(database_dir);
+    if (!oldest->wal_path.empty()) {
+      remove(oldest->wal_path.c_str());
+    }
+    // Only drop the memtable once its SST can be read
+    {
+      lock_guard<mutex> guard(flush_latch);
+      immutables.pop_front();
+    }
 
-    // If the db_type is an LSM_TREE, we need to check if we need to run the
-    // compaction policy
     if (db_type == LSM_TREE) {
       check_LSM_compaction();
       get_ssts_from_db(database_dir);
@@ -806,27 +1386,216 @@ void Database::Put(const int64_t &key, const int64_t &value) {
   }
 }
 
-void Database::set_bufferpool_enabled(bool enabled) {
-  bufferpool_enabled = enabled;
+void Database::queue_memtable() {
+  unique_lock<mutex> lock(flush_latch);
+  // Stall while the flush thread is behind
+  while (immutables.size() >= max_immutables) {
+    if (immutables.front()->flushed) {
+      lock.unlock();
+      install_flushed_memtables();
+      lock.lock();
+    } else {
+      flush_finished.wait(lock);
+    }
+  }
+
+  auto immutable = make_shared<ImmutableMemtable>();
+  immutable->memtable = shared_ptr<Memtable>(memtable.detach());
+  // Not named *.bin, so get_ssts_from_db skips it until it is installed
+  immutable->path = database_dir + "/MEMTABLE_" +
+                    to_string(next_flush_number++) + ".tmp";
+  // Later writes go to a new log, the old one lives as long as the memtable
+  if (wal) {
+    immutable->wal_path = wal->get_path();
+    open_wal();
+  }
+  immutables.push_back(immutable);
+
+  if (!flush_thread.joinable()) {
+    stop_flushing = false;
+    flush_thread = thread(&Database::flush_immutables, this);
+  }
+  flush_queued.notify_one();
 }
 
-string Database::get_db_type() { return db_type; }
+void Database::stop_flush_thread() {
+  if (flush_thread.joinable()) {
+    {
+      lock_guard<mutex> guard(flush_latch);
+      stop_flushing = true;
+    }
+    flush_queued.notify_all();
+    flush_thread.join();
+  }
+  install_flushed_memtables();
+}
 
-void Database::Close() {
-  int memtable_entries = memtable.get_size();
-  if (memtable_entries != 0) {
-    memtable.close();
+void Database::write(const KeyValuePair *pairs, size_t count) {
+  PendingWrite self = {pairs, count, false};
+  unique_lock<mutex> lock(write_latch);
+  writers.push_back(&self);
+  while (!self.done && writers.front() != &self) {
+    write_done.wait(lock);
+  }
+  if (self.done) {
+    return;
+  }
+
+  // Apply the writes of everyone queued so far, in the order they came in
+  vector<PendingWrite *> group(writers.begin(), writers.end());
+  lock.unlock();
+  if (wal) {
+    vector<char> buffer;
+    for (auto writer : group) {
+      WriteAheadLog::encode(writer->pairs, writer->count, buffer);
+    }
+    wal->append(buffer);
+  }
+  if (group.size() == 1 && self.count == 1) {
+    memtable.put(self.pairs[0].key, self.pairs[0].value);
+  } else {
+    // Sort the group once and insert it in one pass. The sort is stable, so
+    // of several writes of a key the last one wins
+    vector<KeyValuePair> pairs;
+    for (auto writer : group) {
+      pairs.insert(pairs.end(), writer->pairs, writer->pairs + writer->count);
+    }
+    stable_sort(pairs.begin(), pairs.end());
+    vector<KeyValuePair> latest;
+    for (size_t i = 0; i < pairs.size(); i++) {
+      if (i + 1 == pairs.size() || pairs[i + 1].key != pairs[i].key) {
+        latest.push_back(pairs[i]);
+      }
+    }
+    memtable.put_sorted(latest);
+  }
+  // Every logged write is in the memtable, so its log can be truncated
+  flush_if_full();
+
+  lock.lock();
+  for (size_t i = 0; i < group.size(); i++) {
+    writers.front()->done = true;
+    writers.pop_front();
+  }
+  write_done.notify_all();
+}
+
+void Database::flush_if_full() {
+  if (max_immutables > 0) {
+    // The flush thread writes full memtables, only install its SSTs
+    install_flushed_memtables();
+    if (memtable.is_full()) {
+      queue_memtable();
+    }
+  } else if (memtable.is_full()) {
+    flush_memtable();
+  }
+}
+
+void Database::flush_memtable() {
+  if (memtable.get_size() == 0) {
+    return;
+  }
+  memtable.close();
+  if (wal) {
+    wal->truncate();
+  }
+  get_ssts_from_db(database_dir);
+
+  // If the db_type is an LSM_TREE, we need to check if we need to run the
+  // compaction policy
+  if (db_type == LSM_TREE) {
+    check_LSM_compaction();
     get_ssts_from_db(database_dir);
+  }
+}
 
-    if (db_type == LSM_TREE) {
-      check_LSM_compaction();
+void Database::Put(const int64_t &key, const int64_t &value) {
+  KeyValuePair pair = {key, value};
+  write(&pair, 1);
+}
+
+void Database::Write(const WriteBatch &batch) {
+  if (batch.Count() == 0) {
+    return;
+  }
+  write(batch.get_pairs().data(), batch.Count());
+}
+
+void Database::set_bufferpool_enabled(bool enabled) {
+  bufferpool_enabled = enabled;
+}
+
+void Database::set_bufferpool_shards(size_t num_shards) {
+  bufferpool.set_num_shards(num_shards);
+}
+
+void Database::set_filter_type(int64_t filter_type) {
+  memtable.set_filter_type(filter_type);
+}
 
-      save_LSM_tree_state(database_dir + "/lsm_tree_state.txt");
+void Database::set_filter_cache_budget(size_t budget) {
+  filter_cache_budget = budget;
+  // Drop resident filters until the usage fits the new budget
+  for (auto &reader : table_readers) {
+    if (filter_cache_usage <= filter_cache_budget) {
+      break;
     }
+    unload_table_reader(*reader);
+  }
+}
+
+void Database::set_async_io_enabled(bool enabled) {
+  if (enabled && !async_reader) {
+    async_reader.reset(new AsyncPageReader());
+  } else if (!enabled) {
+    async_reader.reset();
+  }
+}
+
+void Database::set_background_flush(bool enabled, size_t max_immutable) {
+  if (!enabled || max_immutable == 0) {
+    stop_flush_thread();
+    max_immutables = 0;
   } else {
-    if (db_type == LSM_TREE) {
-      save_LSM_tree_state(database_dir + "/lsm_tree_state.txt");
-    }
+    max_immutables = max_immutable;
+  }
+}
+
+void Database::set_wal_enabled(bool enabled, const string &sync_policy,
+                               int sync_interval_ms) {
+  wal_enabled = enabled;
+  wal_sync_policy = sync_policy;
+  wal_sync_interval_ms = sync_interval_ms;
+  if (wal) {
+    // Nothing may be left in the old log that is not in an SST
+    stop_flush_thread();
+    flush_memtable();
+    string path = wal->get_path();
+    wal.reset();
+    remove(path.c_str());
+  }
+  if (enabled && !database_dir.empty()) {
+    open_wal();
+  }
+}
+
+string Database::get_db_type() { return db_type; }
+
+void Database::Close() {
+  // Write the queued memtables before the active one, which is newer
+  stop_flush_thread();
+  flush_memtable();
+
+  // Everything is in SSTs, there is nothing to replay
+  if (wal) {
+    string path = wal->get_path();
+    wal.reset();
+    remove(path.c_str());
+  }
+
+  if (db_type == LSM_TREE) {
+    save_LSM_tree_state(database_dir + "/lsm_tree_state.txt");
   }
 }
 
@@ -850,7 +1619,8 @@ void Database::save_LSM_tree_state(const string &file_name) {
 void Database::load_LSM_tree_state(const std::string &file_name) {
   std::ifstream file(file_name);
   if (!file.is_open()) {
-    throw std::runtime_error("Unable to open file to load LSM tree state.");
+    // Not closed, the levels are rebuilt from the SSTs
+    return;
   }
 
   std::string line;
@@ -874,3 +1644,13 @@ void Database::load_LSM_tree_state(const std::string &file_name) {
 
   file.close();
 }
+
+void Database::rebuild_LSM_tree_state() {
+  // A compaction writes an SST newer than both of its inputs, so the names
+  // of the SSTs order them by the age of their data, and an older SST
+  // belongs to a higher level. The oldest SST goes to the highest level,
+  // each newer one a level below it, down to the newest at level 1.
+  for (size_t i = 0; i < ssts.size(); i++) {
+    lsm_tree[(int)(ssts.size() - i)].push_back(ssts[i]);
+  }
+}
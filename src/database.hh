@@ -1,71 +1,276 @@
 #ifndef DATABASE_HH_
 #define DATABASE_HH_
 
+#include <condition_variable>
+#include <deque>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "async_page_reader.hh"
 #include "bufferpool.hh"
+#include "iterator.hh"
 #include "memtable.hh"
+#include "table_reader.hh"
+#include "wal.hh"
+#include "write_batch.hh"
 
 struct ScanResponse {
   vector<KeyValuePair> result;
   int size;
 };
 
-struct BSSTMetadata {
-  int64_t entries_offset;
-  int64_t filter_offset;
-  int64_t seeds_offset;
-  int64_t bits_per_entry;
-  int64_t num_entries;
-  int64_t filter_length;
-  int64_t num_seeds;
-  int64_t file_size;
+/**
+ * Aggregates computed by Database::Aggregate over the values of a key range.
+ */
+enum AggregateOp { AGGREGATE_COUNT, AGGREGATE_SUM, AGGREGATE_MIN, AGGREGATE_MAX };
+
+/**
+ * A page to read, used to read several pages at once.
+ */
+struct PageRequest {
+  TableReader *reader;
+  int64_t offset;
+  PageHandle page;  // set to the page read
+};
+
+/**
+ * A full memtable waiting to be flushed by the background flush thread. It is
+ * written to path, a temporary file that is not taken for an SST, and stays
+ * readable until the foreground renames the file into an SST.
+ */
+struct ImmutableMemtable {
+  std::shared_ptr<Memtable> memtable;
+  std::string path;      // temporary file the memtable is written to
+  bool flushed = false;  // set by the flush thread once path is written
+  std::string wal_path;  // log of the writes in the memtable, if any
+};
+
+/**
+ * A write waiting in Database::write for its turn to be applied.
+ */
+struct PendingWrite {
+  const KeyValuePair *pairs;
+  size_t count;
+  bool done;  // set once another writer applied it as part of its group
 };
 
 class Database {
+  // Read leaves with read_page and find_pages
+  friend class BSSTIterator;
+  friend class SortedSSTIterator;
+  friend class AggregateSource;
+
  private:
   Memtable memtable;
   Bufferpool bufferpool;
   std::vector<std::string> ssts;
+  // Open reader of each SST, in the same order as ssts
+  std::vector<std::shared_ptr<TableReader>> table_readers;
   std::string database_dir;
   std::string db_type;
   bool bufferpool_enabled = true;
   std::map<int, std::vector<std::string>> lsm_tree;
+  size_t filter_cache_budget = FILTER_CACHE_BUDGET;  // in bytes
+  size_t filter_cache_usage = 0;  // bytes of Bloom filters held by readers
+  // Reads batches of pages with io_uring, null when asynchronous I/O is off
+  std::unique_ptr<AsyncPageReader> async_reader;
+  // Number given to the next SST that is opened, used in page IDs
+  uint32_t next_file_number = 0;
+  // How SSTs are read, DIRECT_IO or MMAP_IO
+  std::string read_mode;
+  // Full memtables, oldest first. Only the foreground adds or removes them,
+  // under flush_latch, so it may read the queue without the latch.
+  std::deque<std::shared_ptr<ImmutableMemtable>> immutables;
+  // Number of full memtables Put may queue before it stalls, 0 if full
+  // memtables are flushed by Put itself
+  size_t max_immutables = 0;
+  // Number given to the temporary file of the next immutable memtable
+  uint64_t next_flush_number = 0;
+  std::thread flush_thread;   // writes immutable memtables, if enabled
+  bool stop_flushing = false;  // tells flush_thread to exit once idle
+  std::mutex flush_latch;      // guards immutables and stop_flushing
+  std::condition_variable flush_queued;    // a memtable was queued or stop
+  std::condition_variable flush_finished;  // a memtable was written
+  // Log of the writes in the memtable, null if the WAL is disabled
+  std::unique_ptr<WriteAheadLog> wal;
+  bool wal_enabled = false;
+  std::string wal_sync_policy = WAL_SYNC_ALWAYS;
+  int wal_sync_interval_ms = WAL_SYNC_INTERVAL_MS;
+  // Writes waiting to be applied, in arrival order
+  std::deque<PendingWrite *> writers;
+  std::mutex write_latch;               // guards writers
+  std::condition_variable write_done;  // a group of writes was applied
 
-  void find_page(const int &fd, vector<KeyValuePair> &buffer,
-                 const int64_t &offset, const string &file_name);
+  /**
+   * Log count (at least 1) pairs and put them in the memtable. Writers
+   * queue up, and the one in front applies the writes of every writer
+   * queued at that point as a group: one WAL append for all of them, one
+   * sorted pass over the memtable, then a single check for a full memtable.
+   * The others wait until their write is applied.
+   */
+  void write(const KeyValuePair *pairs, size_t count);
+
+  /**
+   * Flush the memtable if it is full, or hand it to the flush thread.
+   */
+  void flush_if_full();
+
+  /**
+   * Write the memtable to an SST and truncate its log, compacting an LSM
+   * tree as needed.
+   */
+  void flush_memtable();
+
+  /**
+   * Start a new log for the writes to the memtable.
+   */
+  void open_wal();
+
+  /**
+   * Remove the memtables a crash left half flushed. Their writes are still
+   * in the logs that replay_wals applies.
+   */
+  void remove_partial_flushes();
+
+  /**
+   * Apply the writes in the logs left in the database directory, e.g. by a
+   * crash, oldest log first. The writes are flushed to an SST before the
+   * logs are removed.
+   */
+  void replay_wals();
+
+  /**
+   * Body of flush_thread. Writes the immutable memtables oldest first until
+   * stop_flushing is set and none is left.
+   */
+  void flush_immutables();
+
+  /**
+   * Turn the written immutable memtables at the front of the queue into
+   * SSTs, oldest first, and drop them from the queue. Each SST is named when
+   * it is installed, so it sorts after every SST written before it,
+   * including those written by compaction.
+   */
+  void install_flushed_memtables();
+
+  /**
+   * Queue the full memtable for the flush thread, waiting while
+   * max_immutables memtables are queued already.
+   */
+  void queue_memtable();
+
+  /**
+   * Wait until every immutable memtable is written, stop the flush thread
+   * and install the memtables.
+   */
+  void stop_flush_thread();
+
+  /**
+   * Return a handle on the page at offset of the SST of reader. Pages in the
+   * bufferpool are pinned in place, missing pages are read straight into a
+   * new frame with the priority given by hint, or into a page owned by the
+   * handle for a COMPACTION_ACCESS.
+   */
+  PageHandle find_page(TableReader &reader, const int64_t &offset,
+                       AccessHint hint = POINT_ACCESS);
+
+  /**
+   * Return a handle on the page at offset of the SST of reader. Mapped SSTs
+   * are read in place, otherwise the page is read through the bufferpool
+   * with find_page.
+   */
+  PageHandle read_page(TableReader &reader, const int64_t &offset,
+                       AccessHint hint = POINT_ACCESS);
+
+  /**
+   * Read the pages of all requests with the given access hint. Pages missing
+   * from the bufferpool are submitted together when asynchronous I/O is
+   * enabled, and read one by one with find_page otherwise.
+   */
+  void find_pages(std::vector<PageRequest> &requests,
+                  AccessHint hint = POINT_ACCESS);
+
+  /**
+   * Search key in all B-tree SSTs that may hold it at the same time, reading
+   * one level of every tree per batch of asynchronous reads. Returns the
+   * value from the newest SST that holds key, or -1.
+   */
+  int64_t parallelSearchBTrees(const int64_t &key);
 
   /**
    * Construct Bloom filter for the databse.
    */
-  BloomFilter construct_bloom_filter(int fd, BSSTMetadata &metadata,
-                                     vector<KeyValuePair> &buffer,
-                                     const string &file_name);
+  BloomFilter construct_bloom_filter(TableReader &reader);
 
   /**
    * Populate the filter vector.
    */
-  void populate_filter_vector(int fd, vector<int64_t> &filter,
-                              BSSTMetadata &metadata,
-                              vector<KeyValuePair> &buffer,
-                              const string &file_name);
+  void populate_filter_vector(TableReader &reader, vector<int64_t> &filter);
 
   /**
    * Populate the seeds vector.
    */
-  void populate_seeds_vector(int fd, vector<int64_t> &seeds,
-                             BSSTMetadata &metadata,
-                             vector<KeyValuePair> &buffer,
-                             const string &file_name);
+  void populate_seeds_vector(TableReader &reader, vector<int64_t> &seeds);
+
+  /**
+   * Load the metadata page and, for LSM trees, the Bloom filter of the SST
+   * into reader, as long as the filter fits in the filter cache budget.
+   */
+  void load_table_reader(TableReader &reader);
+
+  /**
+   * Record the smallest and largest key of a sorted SST in reader, read from
+   * its first and last page.
+   */
+  void load_sorted_sst_key_range(TableReader &reader);
+
+  /**
+   * Release the Bloom filter held by reader and return its memory to the
+   * filter cache budget.
+   */
+  void unload_table_reader(TableReader &reader);
+
+  /**
+   * Return true if the Bloom filter of reader may contain key. Uses the
+   * resident filter, or reads it from the SST if it did not fit the budget.
+   */
+  bool filter_includes(TableReader &reader, const int64_t &key);
+
+  /**
+   * Load the leaf summaries of the BSST of reader, unless they are loaded
+   * already or the SST has none.
+   */
+  void load_leaf_summaries(TableReader &reader);
+
+  /**
+   * Return a DBIterator over the memtable, the immutable memtables and the
+   * SSTs whose key range overlaps [key1, key2], newest first. SST iterators stop reading leaves
+   * at the first key outside [key1, key2] in the direction they move.
+   */
+  std::unique_ptr<Iterator> new_range_iterator(int64_t key1, int64_t key2);
 
  public:
+  /**
+   * read_mode is DIRECT_IO to read SSTs with O_DIRECT through the bufferpool,
+   * or MMAP_IO to map them and let the OS page cache hold them.
+   * eviction_policy is the eviction policy of the bufferpool, LRU_POLICY,
+   * CLOCK_POLICY or ARC_POLICY. memtable_type is AVL_MEMTABLE or
+   * SKIPLIST_MEMTABLE.
+   */
   Database(int memtable_size, size_t bufferpool_capacity,
-           int64_t bits_per_entry = 10);
+           int64_t bits_per_entry = 10, const std::string &read_mode = DIRECT_IO,
+           const std::string &eviction_policy = LRU_POLICY,
+           const std::string &memtable_type = AVL_MEMTABLE);
+  ~Database();
 
   /**
-   * Opens the database and prepares it to run.
+   * Opens the database and prepares it to run. Writes recorded in the
+   * write-ahead logs of the database are replayed and flushed to an SST.
    */
   void Open(const std::string &db_name, const std::string &database_type);
 
@@ -75,40 +280,46 @@ class Database {
   void Close();
 
   /**
-   * Get SSTs from database.
+   * Get SSTs from database. Opens a TableReader for every new SST and
+   * releases the readers of SSTs that no longer exist.
    */
   void get_ssts_from_db(const std::string &db_name);
 
+  /**
+   * Return the TableReader of SST file_name, opening it if it is not
+   * registered yet.
+   */
+  std::shared_ptr<TableReader> get_table_reader(const std::string &file_name);
+
+  /**
+   * Release the TableReader of SST file_name (e.g. before it is deleted).
+   */
+  void release_table_reader(const std::string &file_name);
+
   /**
    * Retrieves a value associated with targetKey in the database in
-   * sorted SST file_name using binary search.
+   * sorted SST of reader using binary search.
    */
-  int64_t binary_search(int64_t targetKey, int file_size, int fd,
-                        const string &file_name);
+  int64_t binary_search(int64_t targetKey, TableReader &reader);
 
   /**
    * Retrieves all KV-pairs in a key range in key order (key1 < key2) in
-   * sorted SST file_name using binary search.
+   * sorted SST of reader using binary search.
    */
-  static std::vector<KeyValuePair> binary_search_scan(int64_t key1,
-                                                      int64_t key2,
-                                                      int file_size, int fd,
-                                                      const string &file_name);
+  std::vector<KeyValuePair> binary_search_scan(int64_t key1, int64_t key2,
+                                               TableReader &reader);
 
   /**
    * Retrieves all KV-pairs in a key range in key order (key1 < key2) in
-   * B-tree SST of file_name.
+   * B-tree SST of reader. Stops reading leaves at the first key after key2.
    */
   std::vector<KeyValuePair> b_tree_scan(int64_t key1, int64_t key2,
-                                        int64_t file_size,
-                                        int64_t entries_offset, int fd,
-                                        const string &file_name);
+                                        TableReader &reader);
 
   /**
-   * Get metadata of B-tree SST of file_name.
+   * Get metadata of B-tree SST of reader.
    */
-  BSSTMetadata get_btree_metadata(int fd, vector<KeyValuePair> &buffer,
-                                  const string &file_name);
+  BSSTMetadata get_btree_metadata(TableReader &reader);
 
   /**
    * Get file size of file_name.
@@ -125,6 +336,14 @@ class Database {
    */
   int64_t Get(const int64_t &key);
 
+  /**
+   * Retrieves the values associated with a batch of keys, in the order of
+   * keys. Keys that are missing or deleted get -1. Each SST is probed once
+   * for the whole batch, and a key found in the memtable or a newer SST is
+   * not probed in older SSTs.
+   */
+  std::vector<int64_t> MultiGet(const std::vector<int64_t> &keys);
+
   /**
    * Update or add a new a KV-pairs in the database.
    */
@@ -136,29 +355,126 @@ class Database {
   ScanResponse Scan(const int64_t &key1, const int64_t &key2);
 
   /**
-   * Stores a key associated with a value in the database.
+   * Retrieves at most limit KV-pairs in a key range in key order (key1 <
+   * key2), reading only the pages that hold them. To fetch the next page of
+   * results, scan again from the last key returned plus one.
+   */
+  ScanResponse Scan(const int64_t &key1, const int64_t &key2, size_t limit);
+
+  /**
+   * Retrieves at most limit KV-pairs in a key range in descending key order
+   * (key1 < key2), starting from key2. Reads only the pages that hold them,
+   * like a forward Scan with a limit.
+   */
+  ScanResponse ReverseScan(
+      const int64_t &key1, const int64_t &key2,
+      size_t limit = std::numeric_limits<size_t>::max());
+
+  /**
+   * Compute op (AGGREGATE_COUNT, AGGREGATE_SUM, AGGREGATE_MIN or
+   * AGGREGATE_MAX) over the values of the keys in a key range (key1 < key2),
+   * without building the list of KV-pairs. Leaves of BSSTs that lie in the
+   * range and whose keys no other source holds are counted from their
+   * summaries without being read. Returns -1 for the minimum or maximum of
+   * an empty range.
+   */
+  int64_t Aggregate(const int64_t &key1, const int64_t &key2, AggregateOp op);
+
+  /**
+   * Return a cursor over all KV-pairs of the database in key order, skipping
+   * deleted keys. It is not positioned until Seek or SeekToFirst is called,
+   * and reads pages lazily as it moves. The database must not be written
+   * while the cursor is in use.
+   */
+  std::unique_ptr<Iterator> NewIterator();
+
+  /**
+   * Stores a key associated with a value in the database. Several threads
+   * may Put at once, their writes are logged with one append to the WAL.
    */
   void Put(const int64_t &key, const int64_t &value);
 
   /**
-   * Search BTree SST of file_name.
+   * Apply every write of batch as one unit: it is logged as a single WAL
+   * record, so it is replayed whole or not at all, inserted into the
+   * memtable in key order in one pass, and the memtable is only flushed
+   * once the whole batch is in it.
+   */
+  void Write(const WriteBatch &batch);
+
+  /**
+   * Search BTree SST of reader.
+   */
+  int64_t searchBTree(const int64_t &key, TableReader &reader);
+
+  /**
+   * Search BTree SST of reader for a batch of keys sorted in ascending order.
+   * The tree is descended once for the whole batch, so every node is read
+   * once no matter how many keys lead to it. values[i] is set to the value of
+   * keys[i], or -1 if the key is not in the SST.
    */
-  int64_t searchBTree(const int64_t &key, int fd, int64_t offset,
-                      int64_t entries_offset, vector<KeyValuePair> &buffer,
-                      const string &file_name);
+  void multiSearchBTree(const std::vector<int64_t> &keys, TableReader &reader,
+                        std::vector<int64_t> &values);
 
   /**
-   * Get scan offset of the given SST of file_name.
+   * Get scan offset of the given SST of reader.
    */
-  int64_t getScanOffset(const int64_t &key, int fd, int64_t offset,
-                        int64_t entries_offset, vector<KeyValuePair> &buffer,
-                        const string &file_name);
+  int64_t getScanOffset(const int64_t &key, TableReader &reader);
 
   /**
    * If enabled is true, enable bufferpool. Otherwise, disable bufferpool.
    */
   void set_bufferpool_enabled(bool enabled);
 
+  /**
+   * Split the bufferpool into num_shards shards, each locked on its own, so
+   * threads reading different pages rarely wait for each other. Pages
+   * already cached are dropped.
+   */
+  void set_bufferpool_shards(size_t num_shards);
+
+  /**
+   * Set the layout of the Bloom filters of SSTs written from now on,
+   * STANDARD_BLOOM_FILTER or BLOCKED_BLOOM_FILTER. Blocked filters hash each
+   * key once and keep all of its bits in one cache line. The layout is
+   * recorded in every SST, so SSTs of both layouts can be read together.
+   */
+  void set_filter_type(int64_t filter_type);
+
+  /**
+   * Set the number of bytes of Bloom filters kept in memory. Filters of SSTs
+   * beyond the budget are read from disk when probed.
+   */
+  void set_filter_cache_budget(size_t budget);
+
+  /**
+   * If enabled is true, read batches of pages with io_uring (falling back to
+   * pread where io_uring is not supported). Otherwise every page is read
+   * with a blocking pread.
+   */
+  void set_async_io_enabled(bool enabled);
+
+  /**
+   * If enabled is true, a full memtable is handed to a background thread
+   * that writes it to an SST while it stays readable, and Put only waits
+   * when max_immutable full memtables are queued already. Otherwise Put
+   * writes full memtables itself. Disabling waits for the queued memtables
+   * to be written.
+   */
+  void set_background_flush(bool enabled,
+                            size_t max_immutable = MAX_IMMUTABLE_MEMTABLES);
+
+  /**
+   * If enabled is true, every write is recorded in a write-ahead log before
+   * it is applied, and the log is replayed by Open if the database was not
+   * closed. sync_policy is WAL_SYNC_ALWAYS to sync the log on every write,
+   * WAL_SYNC_INTERVAL to sync every write at most sync_interval_ms after it,
+   * or WAL_SYNC_NONE to never sync it. Disabling flushes the memtable first.
+   */
+  void set_wal_enabled(bool enabled,
+                       const std::string &sync_policy = WAL_SYNC_ALWAYS,
+                       int sync_interval_ms = WAL_SYNC_INTERVAL_MS);
+
   /**
    * Get SST type of databse.
    */
@@ -180,9 +496,16 @@ class Database {
   void save_LSM_tree_state(const std::string &file_name);
 
   /**
-   * Load LSM tree state of given SST from file_name.
+   * Load LSM tree state of given SST from file_name. A missing file leaves
+   * the LSM tree empty.
    */
   void load_LSM_tree_state(const std::string &file_name);
+
+  /**
+   * Rebuild the LSM tree from the SSTs of a database that was not closed,
+   * one SST per level.
+   */
+  void rebuild_LSM_tree_state();
 };
 
 #endif  // DATABASE_HH_
\ No newline at end of file
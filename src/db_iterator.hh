@@ -0,0 +1,45 @@
+#ifndef DB_ITERATOR_HH_
+#define DB_ITERATOR_HH_
+
+#include <memory>
+#include <vector>
+
+#include "memtable.hh"
+#include "merging_iterator.hh"
+#include "table_reader.hh"
+
+class DBIterator : public Iterator {
+  /**
+   * Cursor over the whole database returned by Database::NewIterator. It
+   * merges the memtables and the SSTs with a MergingIterator and holds on to
+   * the immutable memtables and the readers of the SSTs, so they stay open
+   * even if they are flushed or compacted away while the cursor is in use.
+   *
+   * Pages are only read as the cursor moves, so reading the first n entries
+   * after a Seek only touches the leaves holding them. The memtable must not
+   * be written while the cursor is in use.
+   */
+  std::vector<std::shared_ptr<Memtable>> memtables;   // outlive merged
+  std::vector<std::shared_ptr<TableReader>> readers;  // outlive merged
+  MergingIterator merged;
+
+ public:
+  DBIterator(std::vector<std::shared_ptr<Memtable>> memtables,
+             std::vector<std::shared_ptr<TableReader>> readers,
+             std::vector<std::unique_ptr<Iterator>> sources)
+      : memtables(std::move(memtables)),
+        readers(std::move(readers)),
+        merged(std::move(sources)) {}
+
+  void SeekToFirst() override { merged.SeekToFirst(); }
+  void Seek(int64_t key) override { merged.Seek(key); }
+  void SeekToLast() override { merged.SeekToLast(); }
+  void SeekForPrev(int64_t key) override { merged.SeekForPrev(key); }
+  bool Valid() const override { return merged.Valid(); }
+  void Next() override { merged.Next(); }
+  void Prev() override { merged.Prev(); }
+  int64_t key() const override { return merged.key(); }
+  int64_t value() const override { return merged.value(); }
+};
+
+#endif  // DB_ITERATOR_HH_
@@ -0,0 +1,200 @@
+#include "eviction_policy.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "constants.hh"
+
+using namespace std;
+
+unique_ptr<EvictionPolicy> EvictionPolicy::create(const string &name,
+                                                  size_t capacity) {
+  if (name == LRU_POLICY) {
+    return unique_ptr<EvictionPolicy>(new LRUPolicy(capacity));
+  } else if (name == CLOCK_POLICY) {
+    return unique_ptr<EvictionPolicy>(new ClockPolicy(capacity));
+  } else if (name == ARC_POLICY) {
+    return unique_ptr<EvictionPolicy>(new ARCPolicy(capacity));
+  }
+  throw invalid_argument("Unknown eviction policy: " + name);
+}
+
+void LRUPolicy::insert(size_t frame, PageId page_id, AccessHint hint) {
+  (void)page_id;
+  if (hint == SCAN_ACCESS) {
+    queue.put_head(frame);
+  } else {
+    queue.put(frame);
+  }
+}
+
+void LRUPolicy::access(size_t frame) { queue.move_to_tail(frame); }
+
+void LRUPolicy::remove(size_t frame) { queue.remove_node(frame); }
+
+size_t LRUPolicy::evict(const function<bool(size_t)> &is_pinned) {
+  for (size_t frame = queue.get_head(); frame != LRU_NIL;
+       frame = queue.get_next(frame)) {
+    if (!is_pinned(frame)) {
+      queue.remove_node(frame);
+      return frame;
+    }
+  }
+  return LRU_NIL;
+}
+
+void ClockPolicy::insert(size_t frame, PageId page_id, AccessHint hint) {
+  (void)page_id;
+  resident[frame] = 1;
+  // Scanned pages are taken wherever the hand next passes them
+  referenced[frame] = hint == SCAN_ACCESS ? 0 : CLOCK_INSERTED;
+}
+
+void ClockPolicy::access(size_t frame) { referenced[frame] = CLOCK_HIT; }
+
+void ClockPolicy::remove(size_t frame) {
+  resident[frame] = 0;
+  referenced[frame] = 0;
+}
+
+size_t ClockPolicy::evict(const function<bool(size_t)> &is_pinned) {
+  size_t num_frames = resident.size();
+  // CLOCK_HIT full turns clear every reference count, so an unpinned frame
+  // is found in the turn after if there is one
+  for (size_t step = 0; step < (CLOCK_HIT + 1) * num_frames; step++) {
+    size_t frame = hand;
+    hand = (hand + 1) % num_frames;
+    if (!resident[frame] || is_pinned(frame)) {
+      continue;
+    }
+    if (referenced[frame] > 0) {
+      // Another chance
+      referenced[frame]--;
+      continue;
+    }
+    resident[frame] = 0;
+    return frame;
+  }
+  return LRU_NIL;
+}
+
+void ARCPolicy::GhostList::push(PageId page_id) {
+  index[page_id] = pages.insert(pages.end(), page_id);
+}
+
+void ARCPolicy::GhostList::erase(PageId page_id) {
+  auto it = index.find(page_id);
+  if (it != index.end()) {
+    pages.erase(it->second);
+    index.erase(it);
+  }
+}
+
+void ARCPolicy::GhostList::pop_oldest() {
+  if (!pages.empty()) {
+    index.erase(pages.front());
+    pages.pop_front();
+  }
+}
+
+void ARCPolicy::insert(size_t frame, PageId page_id, AccessHint hint) {
+  frame_page[frame] = page_id;
+  if (hint == SCAN_ACCESS) {
+    // Scanned pages neither adapt the target size nor come back from the
+    // ghost lists, they are the first page of T1 to evict
+    t1.put_head(frame);
+    list_of[frame] = 1;
+    t1_size++;
+    return;
+  }
+  if (b1.contains(page_id)) {
+    // Evicted from T1 too early, give T1 more room
+    size_t delta = max<size_t>(1, b2.size() / b1.size());
+    target_t1 = min(capacity, target_t1 + delta);
+    b1.erase(page_id);
+    t2.put(frame);
+    list_of[frame] = 2;
+    t2_size++;
+    return;
+  }
+  if (b2.contains(page_id)) {
+    // Evicted from T2 too early, give T2 more room
+    size_t delta = max<size_t>(1, b1.size() / b2.size());
+    target_t1 = target_t1 > delta ? target_t1 - delta : 0;
+    b2.erase(page_id);
+    t2.put(frame);
+    list_of[frame] = 2;
+    t2_size++;
+    return;
+  }
+  t1.put(frame);
+  list_of[frame] = 1;
+  t1_size++;
+  // Keep T1 + B1 within capacity and all lists within twice the capacity
+  while (t1_size + b1.size() > capacity && b1.size() > 0) {
+    b1.pop_oldest();
+  }
+  while (t1_size + t2_size + b1.size() + b2.size() > 2 * capacity &&
+         b2.size() > 0) {
+    b2.pop_oldest();
+  }
+}
+
+void ARCPolicy::access(size_t frame) {
+  if (list_of[frame] == 1) {
+    // Seen twice, promote to T2
+    t1.remove_node(frame);
+    t1_size--;
+    t2.put(frame);
+    list_of[frame] = 2;
+    t2_size++;
+  } else if (list_of[frame] == 2) {
+    t2.move_to_tail(frame);
+  }
+}
+
+void ARCPolicy::remove(size_t frame) {
+  if (list_of[frame] == 1) {
+    t1.remove_node(frame);
+    t1_size--;
+  } else if (list_of[frame] == 2) {
+    t2.remove_node(frame);
+    t2_size--;
+  }
+  list_of[frame] = 0;
+  frame_page[frame] = INVALID_PAGE_ID;
+}
+
+size_t ARCPolicy::first_unpinned(const LRUQueue &queue,
+                                 const function<bool(size_t)> &is_pinned) {
+  for (size_t frame = queue.get_head(); frame != LRU_NIL;
+       frame = queue.get_next(frame)) {
+    if (!is_pinned(frame)) {
+      return frame;
+    }
+  }
+  return LRU_NIL;
+}
+
+size_t ARCPolicy::evict(const function<bool(size_t)> &is_pinned) {
+  bool from_t1 = t1_size > 0 && (t1_size > target_t1 || t2_size == 0);
+  size_t frame = first_unpinned(from_t1 ? t1 : t2, is_pinned);
+  if (frame == LRU_NIL) {
+    // Everything in the preferred list is pinned, try the other one
+    from_t1 = !from_t1;
+    frame = first_unpinned(from_t1 ? t1 : t2, is_pinned);
+    if (frame == LRU_NIL) {
+      return LRU_NIL;
+    }
+  }
+
+  // Remember the evicted page in the ghost list of its queue
+  PageId page_id = frame_page[frame];
+  remove(frame);
+  GhostList &ghosts = from_t1 ? b1 : b2;
+  ghosts.push(page_id);
+  if (ghosts.size() > capacity) {
+    ghosts.pop_oldest();
+  }
+  return frame;
+}
@@ -0,0 +1,167 @@
+#ifndef EVICTION_POLICY_HH_
+#define EVICTION_POLICY_HH_
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bufferpoolLRU.hh"
+
+/**
+ * ID of a page: the number of its file in the upper 32 bits and its page
+ * number within the file in the lower 32 bits.
+ */
+typedef uint64_t PageId;
+
+// ID of no page, marks free frames and empty slots
+#define INVALID_PAGE_ID UINT64_MAX
+
+/**
+ * Why a page is read, so pages that will not be read again soon do not push
+ * the hot pages of point lookups out of the bufferpool.
+ */
+enum AccessHint {
+  POINT_ACCESS,      // point lookup, cached normally
+  SCAN_ACCESS,       // range scan, cached at low priority
+  COMPACTION_ACCESS  // compaction input, never cached
+};
+
+class EvictionPolicy {
+  /**
+   * Decides which frame of the bufferpool is evicted next. Frames are
+   * identified by their index in the bufferpool, and the bufferpool tells
+   * the policy when a frame gets a page, is hit, or loses its page.
+   */
+ public:
+  virtual ~EvictionPolicy() {}
+
+  /**
+   * Return the policy named name (LRU_POLICY, CLOCK_POLICY or ARC_POLICY)
+   * for a bufferpool of capacity frames.
+   */
+  static std::unique_ptr<EvictionPolicy> create(const std::string &name,
+                                                size_t capacity);
+
+  /**
+   * Page page_id was loaded into frame. Pages read by a SCAN_ACCESS are
+   * inserted at low priority, i.e. they are evicted first unless hit again.
+   */
+  virtual void insert(size_t frame, PageId page_id, AccessHint hint) = 0;
+
+  /**
+   * The page in frame was hit.
+   */
+  virtual void access(size_t frame) = 0;
+
+  /**
+   * The page in frame was invalidated and is no longer in the bufferpool.
+   */
+  virtual void remove(size_t frame) = 0;
+
+  /**
+   * Choose a frame whose page should be evicted, skipping frames for which
+   * is_pinned returns true, and forget it. Return LRU_NIL if every frame is
+   * pinned.
+   */
+  virtual size_t evict(const std::function<bool(size_t)> &is_pinned) = 0;
+};
+
+/**
+ * Strict LRU: every hit moves the page to the tail of the LRU queue.
+ */
+class LRUPolicy : public EvictionPolicy {
+  LRUQueue queue;
+
+ public:
+  explicit LRUPolicy(size_t capacity) : queue(capacity) {}
+
+  void insert(size_t frame, PageId page_id, AccessHint hint) override;
+  void access(size_t frame) override;
+  void remove(size_t frame) override;
+  size_t evict(const std::function<bool(size_t)> &is_pinned) override;
+};
+
+/**
+ * CLOCK: a hit only sets the reference count of the frame to CLOCK_HIT. The
+ * hand sweeps the frames, decrementing reference counts, and evicts the
+ * first frame whose count is already 0. New pages start at CLOCK_INSERTED
+ * and pages read by a scan at 0, so the next sweep takes scanned pages first,
+ * then pages that were only inserted, before pages that were hit. Scans
+ * never move the hand.
+ */
+class ClockPolicy : public EvictionPolicy {
+  static const uint8_t CLOCK_INSERTED = 1;
+  static const uint8_t CLOCK_HIT = 2;
+
+  std::vector<uint8_t> referenced;  // reference count of each frame
+  std::vector<uint8_t> resident;    // 1 if the frame holds a page
+  size_t hand;                      // next frame to look at
+
+ public:
+  explicit ClockPolicy(size_t capacity)
+      : referenced(capacity, 0), resident(capacity, 0), hand(0) {}
+
+  void insert(size_t frame, PageId page_id, AccessHint hint) override;
+  void access(size_t frame) override;
+  void remove(size_t frame) override;
+  size_t evict(const std::function<bool(size_t)> &is_pinned) override;
+};
+
+/**
+ * ARC (Adaptive Replacement Cache): pages seen once (T1) and pages seen at
+ * least twice (T2) are kept in separate LRU queues, with ghost lists (B1,
+ * B2) remembering the IDs of pages recently evicted from each. Hits in the
+ * ghost lists adapt the target size of T1, so one-off scans only displace
+ * other one-off pages.
+ */
+class ARCPolicy : public EvictionPolicy {
+  /**
+   * LRU list of IDs of evicted pages.
+   */
+  struct GhostList {
+    std::list<PageId> pages;  // least recently evicted first
+    std::unordered_map<PageId, std::list<PageId>::iterator> index;
+
+    bool contains(PageId page_id) const { return index.count(page_id) != 0; }
+    void push(PageId page_id);
+    void erase(PageId page_id);
+    void pop_oldest();
+    size_t size() const { return pages.size(); }
+  };
+
+  size_t capacity;
+  size_t target_t1;                // adaptive target size of T1
+  LRUQueue t1, t2;                 // resident pages seen once / repeatedly
+  size_t t1_size, t2_size;         // number of frames in t1 and t2
+  std::vector<uint8_t> list_of;    // 0 if free, 1 if in t1, 2 if in t2
+  std::vector<PageId> frame_page;  // page in each frame
+  GhostList b1, b2;                // ghosts of t1 and t2
+
+  /**
+   * Return the first unpinned frame of queue from its LRU end, or LRU_NIL.
+   */
+  size_t first_unpinned(const LRUQueue &queue,
+                        const std::function<bool(size_t)> &is_pinned);
+
+ public:
+  explicit ARCPolicy(size_t capacity)
+      : capacity(capacity),
+        target_t1(0),
+        t1(capacity),
+        t2(capacity),
+        t1_size(0),
+        t2_size(0),
+        list_of(capacity, 0),
+        frame_page(capacity, INVALID_PAGE_ID) {}
+
+  void insert(size_t frame, PageId page_id, AccessHint hint) override;
+  void access(size_t frame) override;
+  void remove(size_t frame) override;
+  size_t evict(const std::function<bool(size_t)> &is_pinned) override;
+};
+
+#endif  // EVICTION_POLICY_HH_
@@ -0,0 +1,63 @@
+#ifndef ITERATOR_HH_
+#define ITERATOR_HH_
+
+#include <cstdint>
+
+class Iterator {
+  /**
+   * Iterates over the KV-pairs of one source (the memtable, an SST, or
+   * several sources merged) in ascending or descending key order. Iterators
+   * are cheapest when they keep moving in the direction of their last seek,
+   * turning around may cost another seek.
+   */
+ public:
+  virtual ~Iterator() {}
+
+  /**
+   * Position the iterator at the first entry.
+   */
+  virtual void SeekToFirst() = 0;
+
+  /**
+   * Position the iterator at the first entry with a key >= key.
+   */
+  virtual void Seek(int64_t key) = 0;
+
+  /**
+   * Position the iterator at the last entry.
+   */
+  virtual void SeekToLast() = 0;
+
+  /**
+   * Position the iterator at the last entry with a key <= key.
+   */
+  virtual void SeekForPrev(int64_t key) = 0;
+
+  /**
+   * Return true if the iterator is at an entry.
+   */
+  virtual bool Valid() const = 0;
+
+  /**
+   * Move to the next entry. The iterator must be valid.
+   */
+  virtual void Next() = 0;
+
+  /**
+   * Move to the previous entry. The iterator must be valid.
+   */
+  virtual void Prev() = 0;
+
+  /**
+   * Return the key of the current entry. The iterator must be valid.
+   */
+  virtual int64_t key() const = 0;
+
+  /**
+   * Return the value of the current entry, 0 for a deleted key. The iterator
+   * must be valid.
+   */
+  virtual int64_t value() const = 0;
+};
+
+#endif  // ITERATOR_HH_
@@ -2,17 +2,12 @@
 
 #include <chrono>
 #include <cmath>
-#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 
-#include "btree.hh"
-
-// Sam's include directives
-#include <cassert>
-#include <queue>
-
+#include "bsst_builder.hh"
 #include "constants.hh"
 
 using namespace std;
@@ -24,12 +19,26 @@ Node::Node(const int64_t &key, const int64_t &value)
       right_subtree(nullptr),
       height(0) {}
 
-Memtable::Memtable(int memtable_size, int64_t bits_per_entry)
+Memtable::Memtable(int memtable_size, int64_t bits_per_entry,
+                   const string &memtable_type)
     : root_node(nullptr),
       size(0),
       memtable_size(memtable_size),
       sst_count(0),
-      bits_per_entry(bits_per_entry) {}
+      bits_per_entry(bits_per_entry),
+      filter_type(STANDARD_BLOOM_FILTER),
+      flush_when_full(true) {
+  if (memtable_type == SKIPLIST_MEMTABLE) {
+    skiplist.reset(new SkipList());
+  } else if (memtable_type != AVL_MEMTABLE) {
+    throw invalid_argument("Unknown memtable type: " + memtable_type);
+  }
+}
+
+Memtable::~Memtable() {
+  // The nodes of a skiplist are freed with its arena
+  clearMemtable(root_node);
+}
 
 int Memtable::height(Node *node) {
   if (node == nullptr) {
@@ -131,15 +140,29 @@ int64_t Memtable::get(Node *node, const int64_t &key) {
   }
 }
 
-void Memtable::traverse(Node *node, vector<BTreePair *> &kv_pairs) {
+void Memtable::collectNodes(Node *node, vector<Node *> &nodes) {
   if (node == nullptr) {
     return;
   }
 
-  traverse(node->left_subtree, kv_pairs);
-  BTreePair *key_value_pair = new BTreePair(node->key, node->value);
-  kv_pairs.push_back(key_value_pair);
-  traverse(node->right_subtree, kv_pairs);
+  collectNodes(node->left_subtree, nodes);
+  nodes.push_back(node);
+  collectNodes(node->right_subtree, nodes);
+}
+
+Node *Memtable::buildBalancedTree(vector<Node *> &nodes, size_t begin,
+                                  size_t end) {
+  if (begin == end) {
+    return nullptr;
+  }
+
+  size_t mid = begin + (end - begin) / 2;
+  Node *node = nodes[mid];
+  node->left_subtree = buildBalancedTree(nodes, begin, mid);
+  node->right_subtree = buildBalancedTree(nodes, mid + 1, end);
+  node->height =
+      1 + max(height(node->left_subtree), height(node->right_subtree));
+  return node;
 }
 
 vector<KeyValuePair> Memtable::scan(Node *node, const int64_t &key1,
@@ -171,9 +194,16 @@ vector<KeyValuePair> Memtable::scan(Node *node, const int64_t &key1,
   }
 }
 
-void Memtable::writeToSST(Node *node, std::ofstream &outFile) {
+void Memtable::writeToSST(std::ofstream &outFile) {
   std::vector<char> buffer;
-  writeToSSTBuffered(node, buffer, outFile);
+  if (skiplist) {
+    for (SkipListNode *node = skiplist->first(); node != nullptr;
+         node = node->next[0].load()) {
+      appendToSSTBuffer(node->key, node->value.load(), buffer, outFile);
+    }
+  } else {
+    writeToSSTBuffered(root_node, buffer, outFile);
+  }
 
   // Write any remaining data in the buffer
   if (!buffer.empty()) {
@@ -184,253 +214,34 @@ void Memtable::writeToSST(Node *node, std::ofstream &outFile) {
   outFile.close();
 }
 
-// Function to write buffer to file and reset buffer index
-void flushBSSTBuffer(std::ofstream &file, char *write_buffer,
-                     int &buffer_index) {
-  file.write(write_buffer, buffer_index);
-  if (!file) {
-    cerr << "Write error occurred.\n";
-  }
-  buffer_index = 0;
-}
-
-void Memtable::writeToBSST(BTreeNode *b_tree, std::ofstream &outFile,
-                           BloomFilter &bloom_filter) {
-  // root_node is the root of the BTree
-  queue<BTreeNode *> flush_queue;
-
-  flush_queue.push(b_tree);
-  bool kv_seen = false;
-  int64_t kv_offset = 0;
-  int64_t total_bytes_written = 0;
-
-  // Current assumption is that metadata takes up exactly one 4KB page at the
-  // start Probably will also have to save the offset of the root
-  int64_t internal_offset = 2;
-
-  // Buffered write variables
-  char write_buffer[PAGE_SIZE];
-  int buffer_index = 0;
-
-  // Pad first page with 256 key0 value0 entries to reserve metadata space
-  for (int i = 0; i < PAGE_NUM_ENTRIES; i++) {
-    int64_t padding = 0;
-
-    // Buffered writes of padding (key 0 value 0)
-    memcpy(write_buffer + buffer_index, &padding, sizeof(padding));
-    buffer_index += sizeof(padding);
-    memcpy(write_buffer + buffer_index, &padding, sizeof(padding));
-    buffer_index += sizeof(padding);
-
-    total_bytes_written += ENTRY_SIZE;
-
-    // Check if buffer is full and flush it
-    if (buffer_index >= PAGE_SIZE) {
-      flushBSSTBuffer(outFile, write_buffer, buffer_index);
-    }
-  }
-
-  while (!flush_queue.empty()) {
-    BTreeNode *node = flush_queue.front();
-    flush_queue.pop();
-    int bytes_written = 0;
-
-    for (auto child : node->get_entries()) {
-      if (child->isBTreeNode()) {
-        int64_t child_max_key = dynamic_cast<BTreeNode *>(child)->get_max_key();
-        int64_t temp_internal_offset = internal_offset * PAGE_SIZE;
-
-        // Write max_key to the buffer
-        memcpy(write_buffer + buffer_index, &child_max_key,
-               sizeof(child_max_key));
-        buffer_index += sizeof(child_max_key);
-
-        // Write the child (internal) node's page offset in the SST to buffer
-        memcpy(write_buffer + buffer_index, &temp_internal_offset,
-               sizeof(temp_internal_offset));
-        buffer_index += sizeof(temp_internal_offset);
-
-        // Check if buffer is full and flush it
-        if (buffer_index >= PAGE_SIZE) {
-          flushBSSTBuffer(outFile, write_buffer, buffer_index);
-        }
-
-        internal_offset += 1;
-        flush_queue.push(dynamic_cast<BTreeNode *>(child));
-      } else {
-        // Save the byte offset of the SST entries to later add to the first
-        // page where metadata is stored
-        if (!kv_seen) {
-          kv_offset = total_bytes_written;
-          kv_seen = true;
-        }
-
-        int64_t kv_key = dynamic_cast<BTreePair *>(child)->get_key();
-        int64_t kv_value = dynamic_cast<BTreePair *>(child)->get_value();
-
-        // Write entry
-        memcpy(write_buffer + buffer_index, &kv_key, sizeof(kv_key));
-        buffer_index += sizeof(kv_key);
-
-        memcpy(write_buffer + buffer_index, &kv_value, sizeof(kv_value));
-        buffer_index += sizeof(kv_value);
-
-        // Check if buffer is full and flush it
-        if (buffer_index >= PAGE_SIZE) {
-          flushBSSTBuffer(outFile, write_buffer, buffer_index);
-        }
-      }
-      bytes_written += ENTRY_SIZE;
-      total_bytes_written += ENTRY_SIZE;
-    }
-
-    // Pad page with zeroes
-    while (bytes_written < PAGE_SIZE) {
-      int64_t padding = 0;
-
-      // Buffered writes of padding (key 0 value 0)
-      memcpy(write_buffer + buffer_index, &padding, sizeof(padding));
-      buffer_index += sizeof(padding);
-      memcpy(write_buffer + buffer_index, &padding, sizeof(padding));
-      buffer_index += sizeof(padding);
-
-      bytes_written += ENTRY_SIZE;
-      total_bytes_written += ENTRY_SIZE;
-
-      if (buffer_index >= PAGE_SIZE) {
-        flushBSSTBuffer(outFile, write_buffer, buffer_index);
-      }
-    }
-  }
-
-  assert(total_bytes_written % 4096 == 0);
-  assert(buffer_index == 0);
-
-  // total_bytes_written should now be the offset at which we write bloom filter
-  int64_t filter_offset = total_bytes_written;
-  vector<int64_t> filter = bloom_filter.get_filter();
-
-  // Write filter to file
-  for (int64_t element : filter) {
-    // Buffered writes of filter element
-    memcpy(write_buffer + buffer_index, &element, sizeof(element));
-    buffer_index += sizeof(element);
-    total_bytes_written += 8;
-
-    if (buffer_index >= PAGE_SIZE) {
-      flushBSSTBuffer(outFile, write_buffer, buffer_index);
-    }
-  }
-
-  assert(buffer_index == 0 || (buffer_index > 0 && buffer_index < 4096));
-
-  // Pad with zeroes then flush if the buffer is not empty
-  if (buffer_index > 0 && buffer_index < 4096) {
-    int64_t padding = 0;
-    while (buffer_index < PAGE_SIZE) {
-      memcpy(write_buffer + buffer_index, &padding, sizeof(padding));
-      buffer_index += sizeof(padding);
-      total_bytes_written += 8;
-    }
-    flushBSSTBuffer(outFile, write_buffer, buffer_index);
-  }
-
-  assert(buffer_index == 0);
-  assert(total_bytes_written % 4096 == 0);
-
-  int64_t seeds_offset = total_bytes_written;
-  vector<int64_t> seeds = bloom_filter.get_seeds();
-
-  for (int64_t seed : seeds) {
-    // Buffered writes of seed
-    memcpy(write_buffer + buffer_index, &seed, sizeof(seed));
-    buffer_index += sizeof(seed);
-    total_bytes_written += 8;
-
-    if (buffer_index >= PAGE_SIZE) {
-      flushBSSTBuffer(outFile, write_buffer, buffer_index);
-    }
-  }
-
-  // Pad with zeroes then flush if the buffer is not empty
-  if (buffer_index > 0 && buffer_index < 4096) {
-    int64_t padding = 0;
-    while (buffer_index < PAGE_SIZE) {
-      memcpy(write_buffer + buffer_index, &padding, sizeof(padding));
-      buffer_index += sizeof(padding);
-      total_bytes_written += 8;
-    }
-    flushBSSTBuffer(outFile, write_buffer, buffer_index);
-  }
-
-  assert(buffer_index == 0);
-  assert(total_bytes_written % 4096 == 0);
-
-  int64_t file_size = total_bytes_written;
-  int64_t bits_per_entry = bloom_filter.get_bits_per_entry();
-  int64_t num_entries = bloom_filter.get_num_entries();
-  int64_t filter_vector_size = bloom_filter.get_filter_size();
-  int64_t num_seeds = bloom_filter.get_num_hash_functions();
-
-  // Writing metadata to first page
-  memcpy(write_buffer + buffer_index, &kv_offset, sizeof(kv_offset));
-  buffer_index += 8;
-  memcpy(write_buffer + buffer_index, &filter_offset, sizeof(filter_offset));
-  buffer_index += 8;
-  memcpy(write_buffer + buffer_index, &seeds_offset, sizeof(seeds_offset));
-  buffer_index += 8;
-  memcpy(write_buffer + buffer_index, &bits_per_entry, sizeof(bits_per_entry));
-  buffer_index += 8;
-  memcpy(write_buffer + buffer_index, &num_entries, sizeof(num_entries));
-  buffer_index += 8;
-  memcpy(write_buffer + buffer_index, &filter_vector_size,
-         sizeof(filter_vector_size));
-  buffer_index += 8;
-  memcpy(write_buffer + buffer_index, &num_seeds, sizeof(num_seeds));
-  buffer_index += 8;
-  memcpy(write_buffer + buffer_index, &file_size, sizeof(file_size));
-  buffer_index += 8;
-
-  outFile.seekp(0);
-
-  // Pad with zeroes then flush if the buffer is not empty
-  if (buffer_index > 0 && buffer_index < 4096) {
-    int64_t padding = 0;
-    while (buffer_index < PAGE_SIZE) {
-      memcpy(write_buffer + buffer_index, &padding, sizeof(padding));
-      buffer_index += sizeof(padding);
-    }
-    flushBSSTBuffer(outFile, write_buffer, buffer_index);
-  }
-
-  assert(buffer_index == 0);
-  assert(total_bytes_written % 4096 == 0);
-}
-
 void Memtable::writeToSSTBuffered(Node *node, std::vector<char> &buffer,
                                   std::ofstream &outFile) {
   if (node) {
     writeToSSTBuffered(node->left_subtree, buffer, outFile);
+    appendToSSTBuffer(node->key, node->value, buffer, outFile);
+    writeToSSTBuffered(node->right_subtree, buffer, outFile);
+  }
+}
 
-    int64_t data[2] = {node->key, node->value};
-    size_t dataSize = sizeof(data);
-
-    if (buffer.size() + dataSize > PAGE_SIZE) {
-      padBuffer(buffer);
-      outFile.write(buffer.data(), buffer.size());
-      buffer.clear();
-    }
+void Memtable::appendToSSTBuffer(int64_t key, int64_t value,
+                                 std::vector<char> &buffer,
+                                 std::ofstream &outFile) {
+  int64_t data[2] = {key, value};
+  size_t dataSize = sizeof(data);
 
-    // Add data to buffer
-    buffer.insert(buffer.end(), reinterpret_cast<char *>(&data[0]),
-                  reinterpret_cast<char *>(&data[0]) + dataSize);
+  if (buffer.size() + dataSize > PAGE_SIZE) {
+    padBuffer(buffer);
+    outFile.write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
 
-    if (buffer.size() >= PAGE_SIZE) {
-      outFile.write(buffer.data(), buffer.size());
-      buffer.clear();
-    }
+  // Add data to buffer
+  buffer.insert(buffer.end(), reinterpret_cast<char *>(&data[0]),
+                reinterpret_cast<char *>(&data[0]) + dataSize);
 
-    writeToSSTBuffered(node->right_subtree, buffer, outFile);
+  if (buffer.size() >= PAGE_SIZE) {
+    outFile.write(buffer.data(), buffer.size());
+    buffer.clear();
   }
 }
 
@@ -447,214 +258,318 @@ void Memtable::clearMemtable(Node *node) {
   }
 }
 
-void Memtable::convertMemtableToSST() {
-  if (size == 0) {
-    return;
+void Memtable::clear() {
+  if (skiplist) {
+    skiplist.reset(new SkipList());
+  } else {
+    clearMemtable(root_node);
+    root_node = nullptr;
   }
+  size = 0;
+}
 
-  string filename =
-      database_name + "/SST_" +
-      std::to_string(
-          std::chrono::system_clock::now().time_since_epoch().count()) +
-      ".bin";
+void Memtable::writeSSTFile(const string &filename) {
   ofstream outFile(filename);
-
-  writeToSST(root_node, outFile);
+  writeToSST(outFile);
   outFile.close();
+}
 
+void Memtable::convertMemtableToSST() {
+  if (get_size() == 0) {
+    return;
+  }
+
+  writeSSTFile(new_sst_path());
   sst_count += 1;
 
   // Cear the current memtable
-  clearMemtable(root_node);
-  root_node = nullptr;
-  size = 0;
+  clear();
 }
 
-BTreeNode *Memtable::constructBTree(BloomFilter &bloom_filter,
-                                    vector<BTreePair *> kv_pairs = {}) {
-  if (kv_pairs.empty()) {
-    traverse(kv_pairs);
+void Memtable::writeToBSST(const string &filename, Iterator &entries,
+                           int64_t max_entries) {
+  BSSTBuilder builder(filename, max_entries, get_bits_per_entry(),
+                      filter_type);
+  for (; entries.Valid(); entries.Next()) {
+    builder.add(entries.key(), entries.value());
   }
+  builder.finish();
+}
 
-  // CREATING LEAF NODES
-  queue<BTreeNode *> leaf_nodes;
-  auto *curr_leaf = new BTreeNode();
+void Memtable::writeBSSTFile(const string &filename) {
+  MemtableIterator entries(*this);
+  entries.SeekToFirst();
+  writeToBSST(filename, entries, get_size());
+}
 
-  for (auto kv_pair : kv_pairs) {
-    curr_leaf->insert(kv_pair);
-    bloom_filter.insert(kv_pair->get_key());
-    if (curr_leaf->get_size() >= PAGE_NUM_ENTRIES) {
-      leaf_nodes.push(curr_leaf);
-      curr_leaf = new BTreeNode();
-    }
+void Memtable::convertMemtableToBSST() {
+  if (get_size() == 0) {
+    return;
   }
 
-  if (curr_leaf->get_size() > 0) {
-    leaf_nodes.push(curr_leaf);
-  }
+  writeBSSTFile(new_sst_path());
+  sst_count += 1;
 
-  auto *btree_root = new BTreeNode();
+  // Clear the current memtable
+  clear();
+}
+
+void Memtable::CreateCompactedBSST(const string &filename, Iterator &entries,
+                                   int64_t max_entries) {
+  writeToBSST(filename, entries, max_entries);
+}
 
-  if (leaf_nodes.size() == 1) {
-    // There are 256 entries or fewer being flushed
-    // The leaf itself can be the root node
-    btree_root = leaf_nodes.front();
+bool Memtable::put(const int64_t &key, const int64_t &value) {
+  // If memtable is flushed to SST return true, otherwise false
+  bool flushedToSST = false;
+  if (skiplist) {
+    skiplist->insert(key, value);
   } else {
-    // There are more than 256 entries being flushed
-    // Thus we have at least two leaf nodes that should be referenced by a
-    // parent
-    bool root_ready = false;
-    queue<BTreeNode *> internal_nodes;
-
-    while (!root_ready) {
-      int num_leaves = leaf_nodes.size();
-      auto *curr_node = new BTreeNode();
-      int num_internal =
-          ceil(static_cast<double>(num_leaves) / PAGE_NUM_ENTRIES);
-      int base_distribution = num_leaves / num_internal;
-      int num_extras = num_leaves % num_internal;
-
-      while (num_leaves > 0) {
-        BTreeNode *leaf = leaf_nodes.front();
-        leaf_nodes.pop();
-        curr_node->insert(leaf);
-        num_leaves--;
-        if (num_extras > 0 &&
-            curr_node->get_size() == (base_distribution + 1)) {
-          num_extras--;
-          internal_nodes.push(curr_node);
-          curr_node = new BTreeNode();
-        } else if (num_extras == 0 &&
-                   curr_node->get_size() == base_distribution) {
-          internal_nodes.push(curr_node);
-          curr_node = new BTreeNode();
-        }
-      }
-
-      if (internal_nodes.size() <= PAGE_NUM_ENTRIES) {
-        root_ready = true;
-      } else {
-        leaf_nodes = internal_nodes;
-        std::queue<BTreeNode *> empty;
-        std::swap(empty, internal_nodes);
-      }
-    }
+    root_node = put(root_node, key, value);
+  }
 
-    if (internal_nodes.size() == 1) {
-      // There is only one internal node left, make it the root
-      btree_root = internal_nodes.front();
+  if (flush_when_full && is_full()) {
+    if (db_type == BSST || db_type == LSM_TREE) {
+      convertMemtableToBSST();
     } else {
-      // There are less than 256 internal nodes, thus we insert them all into
-      // a parent node and return the parent node
-      btree_root = new BTreeNode();
-      // Insert all nodes in internal_nodes to root_node
-      while (!internal_nodes.empty()) {
-        btree_root->insert(internal_nodes.front());
-        internal_nodes.pop();
-      }
+      convertMemtableToSST();
     }
+    flushedToSST = true;
   }
 
-  return btree_root;
+  return flushedToSST;
 }
 
-void Memtable::convertMemtableToBSST() {
-  if (size == 0) {
+void Memtable::put_sorted(const vector<KeyValuePair> &pairs) {
+  if (skiplist) {
+    // Each insert searches on from the previous key
+    SkipListNode *splice[SKIPLIST_MAX_HEIGHT] = {};
+    for (const auto &pair : pairs) {
+      skiplist->insert(pair.key, pair.value, splice);
+    }
     return;
   }
 
-  string filename =
-      database_name + "/BSST_" +
-      std::to_string(
-          std::chrono::system_clock::now().time_since_epoch().count()) +
-      ".bin";
-  ofstream outFile(filename, ios::binary);
-  if (!outFile) {
-    cerr << "Could not open file for writing.\n";
-    throw runtime_error("Could not open file for writing.");
+  // Inserting the pairs one by one costs about log2(size) steps each, a
+  // merge costs one step per node and pair
+  if (pairs.size() * log2(size + 2.0) < size + pairs.size()) {
+    for (const auto &pair : pairs) {
+      root_node = put(root_node, pair.key, pair.value);
+    }
+    return;
   }
 
-  BloomFilter bloom_filter(get_size(), get_bits_per_entry());
-  BTreeNode *b_tree = constructBTree(bloom_filter);
-  writeToBSST(b_tree, outFile, bloom_filter);
+  vector<Node *> nodes;
+  collectNodes(root_node, nodes);
+  vector<Node *> merged;
+  merged.reserve(nodes.size() + pairs.size());
+  size_t i = 0;
+  for (const auto &pair : pairs) {
+    while (i < nodes.size() && nodes[i]->key < pair.key) {
+      merged.push_back(nodes[i++]);
+    }
+    if (i < nodes.size() && nodes[i]->key == pair.key) {
+      nodes[i]->value = pair.value;
+      merged.push_back(nodes[i++]);
+    } else {
+      merged.push_back(new Node(pair.key, pair.value));
+      size += 1;
+    }
+  }
+  merged.insert(merged.end(), nodes.begin() + i, nodes.end());
+  root_node = buildBalancedTree(merged, 0, merged.size());
+}
 
-  outFile.close();
-  sst_count += 1;
+void Memtable::close() {
+  if (db_type == BSST || db_type == LSM_TREE) {
+    convertMemtableToBSST();
+  } else {
+    convertMemtableToSST();
+  }
+}
 
-  // Clear b_tree
-  EntryBase::clearBTree(b_tree);
-  b_tree = nullptr;
+void Memtable::set_flush_when_full(bool enabled) { flush_when_full = enabled; }
+
+bool Memtable::is_full() const { return get_size() >= memtable_size; }
+
+unique_ptr<Memtable> Memtable::detach() {
+  unique_ptr<Memtable> full(new Memtable(
+      memtable_size, bits_per_entry,
+      skiplist ? SKIPLIST_MEMTABLE : AVL_MEMTABLE));
+  full->database_name = database_name;
+  full->db_type = db_type;
+  full->filter_type = filter_type;
+  // The new memtable starts empty, so swapping leaves this one empty
+  swap(full->root_node, root_node);
+  swap(full->skiplist, skiplist);
+  swap(full->size, size);
+  return full;
+}
 
-  // Clear the current memtable
-  clearMemtable(root_node);
-  root_node = nullptr;
-  size = 0;
+void Memtable::flush_to(const string &filename) {
+  if (db_type == BSST || db_type == LSM_TREE) {
+    writeBSSTFile(filename);
+  } else {
+    writeSSTFile(filename);
+  }
 }
 
-void Memtable::CreateCompactedBSST(const string &filename,
-                                   vector<BTreePair *> &kv_pairs,
-                                   int64_t merged_size) {
-  ofstream outFile(filename, ios::binary);
-  if (!outFile) {
-    cerr << "Could not open file for writing.\n";
-    throw runtime_error("Could not open file for writing.");
+string Memtable::new_sst_path() const {
+  string prefix = db_type == BSST || db_type == LSM_TREE ? "/BSST_" : "/SST_";
+  return database_name + prefix +
+         std::to_string(
+             std::chrono::system_clock::now().time_since_epoch().count()) +
+         ".bin";
+}
+
+int64_t Memtable::get(const int64_t &key) {
+  if (skiplist) {
+    int64_t value;
+    return skiplist->get(key, value) ? value : -1;
   }
+  return get(root_node, key);
+}
 
-  BloomFilter bloom_filter(merged_size, get_bits_per_entry());
-  BTreeNode *b_tree = constructBTree(bloom_filter, kv_pairs);
+vector<KeyValuePair> Memtable::scan(const int64_t &key1, const int64_t &key2) {
+  if (skiplist) {
+    vector<KeyValuePair> values;
+    for (SkipListNode *node = skiplist->seek(key1);
+         node != nullptr && node->key <= key2; node = node->next[0].load()) {
+      values.push_back(KeyValuePair{node->key, node->value.load()});
+    }
+    return values;
+  }
+  return scan(root_node, key1, key2);
+}
 
-  writeToBSST(b_tree, outFile, bloom_filter);
+void Memtable::set_db_name(const string &db_name) { database_name = db_name; }
 
-  outFile.close();
+void MemtableIterator::push_left(Node *node) {
+  while (node != nullptr) {
+    stack.push_back(node);
+    node = node->left_subtree;
+  }
+}
 
-  // Clear b_tree
-  EntryBase::clearBTree(b_tree);
-  b_tree = nullptr;
+void MemtableIterator::push_right(Node *node) {
+  while (node != nullptr) {
+    stack.push_back(node);
+    node = node->right_subtree;
+  }
 }
 
-bool Memtable::put(const int64_t &key, const int64_t &value) {
-  // If memtable is flushed to SST return true, otherwise false
-  bool flushedToSST = false;
-  root_node = put(root_node, key, value);
+void MemtableIterator::SeekToFirst() {
+  forward = true;
+  if (memtable.skiplist) {
+    list_node = memtable.skiplist->first();
+    return;
+  }
+  stack.clear();
+  push_left(memtable.root_node);
+}
 
-  if (size >= memtable_size) {
-    if (db_type == BSST || db_type == LSM_TREE) {
-      convertMemtableToBSST();
+void MemtableIterator::Seek(int64_t key) {
+  forward = true;
+  if (memtable.skiplist) {
+    list_node = memtable.skiplist->seek(key);
+    return;
+  }
+  stack.clear();
+  Node *node = memtable.root_node;
+  // Keep the path of nodes with a key >= key, the smallest ends up on top
+  while (node != nullptr) {
+    if (node->key >= key) {
+      stack.push_back(node);
+      node = node->left_subtree;
     } else {
-      convertMemtableToSST();
+      node = node->right_subtree;
     }
-    flushedToSST = true;
   }
+}
 
-  return flushedToSST;
+void MemtableIterator::SeekToLast() {
+  forward = false;
+  if (memtable.skiplist) {
+    list_node = memtable.skiplist->last();
+    return;
+  }
+  stack.clear();
+  push_right(memtable.root_node);
 }
 
-void Memtable::close() {
-  if (db_type == BSST || db_type == LSM_TREE) {
-    convertMemtableToBSST();
-  } else {
-    convertMemtableToSST();
+void MemtableIterator::SeekForPrev(int64_t key) {
+  forward = false;
+  if (memtable.skiplist) {
+    list_node = memtable.skiplist->seek(key);
+    if (list_node == nullptr || list_node->key != key) {
+      list_node = memtable.skiplist->seek_less_than(key);
+    }
+    return;
+  }
+  stack.clear();
+  Node *node = memtable.root_node;
+  // Keep the path of nodes with a key <= key, the largest ends up on top
+  while (node != nullptr) {
+    if (node->key <= key) {
+      stack.push_back(node);
+      node = node->right_subtree;
+    } else {
+      node = node->left_subtree;
+    }
   }
 }
 
-int64_t Memtable::get(const int64_t &key) { return get(root_node, key); }
+bool MemtableIterator::Valid() const {
+  return memtable.skiplist ? list_node != nullptr : !stack.empty();
+}
 
-vector<KeyValuePair> Memtable::scan(const int64_t &key1, const int64_t &key2) {
-  return scan(root_node, key1, key2);
+int64_t MemtableIterator::key() const {
+  return memtable.skiplist ? list_node->key : stack.back()->key;
 }
 
-void Memtable::set_db_name(const string &db_name) { database_name = db_name; }
+int64_t MemtableIterator::value() const {
+  return memtable.skiplist ? list_node->value.load() : stack.back()->value;
+}
 
-void Memtable::set_sst_count(const int &count) { sst_count = count; }
+void MemtableIterator::Next() {
+  if (memtable.skiplist) {
+    // The bottom level links every node, in both directions of iteration
+    list_node = list_node->next[0].load();
+    return;
+  }
+  if (!forward) {
+    Seek(key() + 1);
+    return;
+  }
+  Node *node = stack.back();
+  stack.pop_back();
+  push_left(node->right_subtree);
+}
 
-void Memtable::traverse(std::vector<BTreePair *> &kv_pairs) {
-  traverse(root_node, kv_pairs);
+void MemtableIterator::Prev() {
+  if (memtable.skiplist) {
+    list_node = memtable.skiplist->seek_less_than(list_node->key);
+    return;
+  }
+  if (forward) {
+    SeekForPrev(key() - 1);
+    return;
+  }
+  Node *node = stack.back();
+  stack.pop_back();
+  push_right(node->left_subtree);
 }
 
-int Memtable::get_size() const { return size; }
+void Memtable::set_sst_count(const int &count) { sst_count = count; }
+
+int Memtable::get_size() const {
+  return skiplist ? (int)skiplist->size() : size;
+}
 
 void Memtable::set_db_type(const std::string &database_type) {
   db_type = database_type;
 }
 
 int Memtable::get_bits_per_entry() { return bits_per_entry; }
+
+void Memtable::set_filter_type(int64_t type) { filter_type = type; }
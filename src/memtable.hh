@@ -3,11 +3,15 @@
 #include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "bloom-filter.hh"
-#include "btree.hh"
+#include "constants.hh"
+#include "iterator.hh"
+#include "skiplist.hh"
 
 using namespace std;
 
@@ -30,14 +34,21 @@ class Node {
 };
 
 class Memtable {
+  // Walks the AVL tree in order
+  friend class MemtableIterator;
+
  private:
   Node *root_node;
-  int size;
+  // Used instead of the AVL tree for a SKIPLIST_MEMTABLE, null otherwise
+  std::unique_ptr<SkipList> skiplist;
+  int size;  // number of keys in the AVL tree
   int memtable_size;
   int sst_count;
   string database_name;
   string db_type;
   int64_t bits_per_entry;
+  int64_t filter_type;  // layout of the Bloom filters written to BSSTs
+  bool flush_when_full;  // false if put leaves a full memtable to the caller
 
   /**
    * Returns the height of the given node in an AVL tree.
@@ -72,6 +83,18 @@ class Memtable {
    */
   int64_t get(Node *node, const int64_t &key);
 
+  /**
+   * Appends the nodes of the AVL tree to nodes in key order.
+   */
+  void collectNodes(Node *node, std::vector<Node *> &nodes);
+
+  /**
+   * Links nodes[begin, end), sorted by key, into a balanced AVL tree and
+   * returns its root.
+   */
+  Node *buildBalancedTree(std::vector<Node *> &nodes, size_t begin,
+                          size_t end);
+
   /**
    * Returns a vector of key-value pairs in the specified key range [key1, key2]
    * in the AVL tree.
@@ -80,15 +103,23 @@ class Memtable {
                                  const int64_t &key2);
 
   /**
-   * Writes the AVL tree to an SST file, using a buffer for optimization.
+   * Writes the memtable to an SST file, using a buffer for optimization.
    */
-  void writeToSST(Node *node, std::ofstream &outFile);
+  void writeToSST(std::ofstream &outFile);
 
   /**
-   * Writes the B-tree to a BSST file, including Bloom filter data and metadata.
+   * Appends one KV-pair to the SST buffer, writing the buffer out one page
+   * at a time.
    */
-  static void writeToBSST(BTreeNode *b_tree, std::ofstream &outFile,
-                          BloomFilter &bloom_filter);
+  void appendToSSTBuffer(int64_t key, int64_t value, std::vector<char> &buffer,
+                         std::ofstream &outFile);
+
+  /**
+   * Writes the KV-pairs of entries, from its current position on, to the
+   * BSST file filename, with a Bloom filter sized for max_entries pairs.
+   */
+  void writeToBSST(const std::string &filename, Iterator &entries,
+                   int64_t max_entries);
 
   /**
    * Writes the AVL tree to an SST file using a buffer to manage data.
@@ -107,35 +138,56 @@ class Memtable {
   void clearMemtable(Node *node);
 
   /**
-   * Converts the AVL tree to an SST file and resets the Memtable.
+   * Empty the memtable after a flush. A skiplist is replaced by a new one,
+   * freeing all of its nodes at once with its arena.
    */
-  void convertMemtableToSST();
+  void clear();
 
   /**
-   * Converts the AVL tree to a BSST file, applying a Bloom filter.
+   * Writes the memtable to the SST file filename without clearing it.
    */
-  void convertMemtableToBSST();
+  void writeSSTFile(const std::string &filename);
+
+  /**
+   * Writes the memtable to the BSST file filename without clearing it.
+   */
+  void writeBSSTFile(const std::string &filename);
 
   /**
-   * Constructs a B-tree from key-value pairs, updating the Bloom filter.
+   * Converts the AVL tree to an SST file and resets the Memtable.
    */
-  BTreeNode *constructBTree(BloomFilter &bloom_filter,
-                            std::vector<BTreePair *> kv_pairs);
+  void convertMemtableToSST();
 
   /**
-   * Performs an in-order traversal of the AVL tree, collecting key-value pairs.
+   * Converts the AVL tree to a BSST file, applying a Bloom filter.
    */
-  void traverse(Node *node, vector<BTreePair *> &kv_pairs);
+  void convertMemtableToBSST();
 
  public:
-  Memtable(int memtable_size, int64_t bits_per_entry = 10);
+  /**
+   * memtable_type is AVL_MEMTABLE for an AVL tree, or SKIPLIST_MEMTABLE for
+   * a skiplist whose nodes are allocated from an arena. Throws
+   * invalid_argument for any other type.
+   */
+  Memtable(int memtable_size, int64_t bits_per_entry = 10,
+           const std::string &memtable_type = AVL_MEMTABLE);
+  ~Memtable();
 
   /**
    * Inserts a key-value pair into the Memtable, potentially triggering
-   * conversion to SST/BSST.
+   * conversion to SST/BSST. With a SKIPLIST_MEMTABLE several threads may put
+   * at once, as long as none of the puts fills up the memtable.
    */
   bool put(const int64_t &key, const int64_t &value);
 
+  /**
+   * Inserts KV-pairs sorted by key, with no key twice, in one pass. When
+   * there are enough of them, the AVL tree is merged with the pairs and
+   * rebuilt balanced instead of being searched once per pair. Never
+   * triggers a flush, the caller checks is_full afterwards.
+   */
+  void put_sorted(const std::vector<KeyValuePair> &pairs);
+
   /**
    * Retrieves the value associated with a specified key from the AVL tree.
    */
@@ -156,11 +208,6 @@ class Memtable {
    */
   void set_sst_count(const int &count);
 
-  /**
-   * Traverses the AVL tree to collect key-value pairs.
-   */
-  void traverse(std::vector<BTreePair *> &kv_pairs);
-
   /**
    * Returns the size of the Memtable.
    */
@@ -176,14 +223,94 @@ class Memtable {
    */
   void close();
 
+  /**
+   * If enabled is false, put no longer flushes the memtable once it is
+   * full, the caller checks is_full and detaches it instead.
+   */
+  void set_flush_when_full(bool enabled);
+
+  /**
+   * Return true if the memtable holds memtable_size keys or more.
+   */
+  bool is_full() const;
+
+  /**
+   * Move the contents of the memtable into a new memtable with the same
+   * settings and return it, leaving this memtable empty. The returned
+   * memtable is not written to any more, so it can be read while another
+   * thread flushes it with flush_to.
+   */
+  std::unique_ptr<Memtable> detach();
+
+  /**
+   * Write the memtable to the SST or BSST file filename, depending on the
+   * type of the database, without clearing it. Only reads the memtable.
+   */
+  void flush_to(const std::string &filename);
+
+  /**
+   * Return the path of a new SST of the database, named after the current
+   * time so it sorts after every SST written before.
+   */
+  std::string new_sst_path() const;
+
   /**
    * Returns the number of bits per entry used in the Memtable.
    */
   int get_bits_per_entry();
 
   /**
-   * Creates a compacted BSST file from a set of B-tree pairs.
+   * Sets the layout of the Bloom filters of the BSSTs written from now on,
+   * STANDARD_BLOOM_FILTER or BLOCKED_BLOOM_FILTER.
    */
-  void CreateCompactedBSST(const std::string &filename,
-                           std::vector<BTreePair *> &kv_pairs, int64_t size);
+  void set_filter_type(int64_t type);
+
+  /**
+   * Creates a compacted BSST file from the KV-pairs of entries, from its
+   * current position on, in ascending key order. max_entries bounds their
+   * number and sizes the Bloom filter.
+   */
+  void CreateCompactedBSST(const std::string &filename, Iterator &entries,
+                           int64_t max_entries);
+};
+
+class MemtableIterator : public Iterator {
+  /**
+   * Walks the AVL tree of a memtable in key order without copying it. The
+   * stack holds the nodes whose key is still to be returned, the current
+   * node on top. Going backwards the stack mirrors that, holding the nodes
+   * whose key is still to be returned in descending order. The memtable must
+   * not change while it is iterated.
+   *
+   * A skiplist memtable is walked along its bottom level instead, and may
+   * be written to while it is iterated.
+   */
+  const Memtable &memtable;
+  std::vector<Node *> stack;
+  bool forward;  // true if the stack is in ascending order
+  SkipListNode *list_node;  // current node of a skiplist memtable
+
+  /**
+   * Push node and its chain of left children onto the stack.
+   */
+  void push_left(Node *node);
+
+  /**
+   * Push node and its chain of right children onto the stack.
+   */
+  void push_right(Node *node);
+
+ public:
+  explicit MemtableIterator(const Memtable &memtable)
+      : memtable(memtable), forward(true), list_node(nullptr) {}
+
+  void SeekToFirst() override;
+  void Seek(int64_t key) override;
+  void SeekToLast() override;
+  void SeekForPrev(int64_t key) override;
+  bool Valid() const override;
+  void Next() override;
+  void Prev() override;
+  int64_t key() const override;
+  int64_t value() const override;
 };
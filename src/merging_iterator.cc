@@ -0,0 +1,120 @@
+#include "merging_iterator.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+MergingIterator::MergingIterator(vector<unique_ptr<Iterator>> children,
+                                 bool keep_tombstones)
+    : children(std::move(children)),
+      keep_tombstones(keep_tombstones),
+      forward(true),
+      valid(false),
+      current_key(0),
+      current_value(0) {}
+
+bool MergingIterator::after(size_t a, size_t b) const {
+  int64_t key_a = children[a]->key();
+  int64_t key_b = children[b]->key();
+  // On equal keys the newer child, with the lower index, comes first
+  if (key_a == key_b) {
+    return a > b;
+  }
+  return forward ? key_a > key_b : key_a < key_b;
+}
+
+void MergingIterator::build_heap() {
+  heap.clear();
+  for (size_t i = 0; i < children.size(); i++) {
+    if (children[i]->Valid()) {
+      heap.push_back(i);
+    }
+  }
+  auto comp = [this](size_t a, size_t b) { return after(a, b); };
+  make_heap(heap.begin(), heap.end(), comp);
+}
+
+void MergingIterator::find_next() {
+  auto comp = [this](size_t a, size_t b) { return after(a, b); };
+  while (!heap.empty()) {
+    // The top of the heap is the newest version of the next key
+    current_key = children[heap.front()]->key();
+    current_value = children[heap.front()]->value();
+
+    // Move every child past the key, dropping the older versions
+    while (!heap.empty() && children[heap.front()]->key() == current_key) {
+      pop_heap(heap.begin(), heap.end(), comp);
+      size_t child = heap.back();
+      if (forward) {
+        children[child]->Next();
+      } else {
+        children[child]->Prev();
+      }
+      if (children[child]->Valid()) {
+        push_heap(heap.begin(), heap.end(), comp);
+      } else {
+        heap.pop_back();
+      }
+    }
+
+    // A value of 0 marks a deleted key
+    if (keep_tombstones || current_value != 0) {
+      valid = true;
+      return;
+    }
+  }
+  valid = false;
+}
+
+void MergingIterator::SeekToFirst() {
+  forward = true;
+  for (auto &child : children) {
+    child->SeekToFirst();
+  }
+  build_heap();
+  find_next();
+}
+
+void MergingIterator::Seek(int64_t key) {
+  forward = true;
+  for (auto &child : children) {
+    child->Seek(key);
+  }
+  build_heap();
+  find_next();
+}
+
+void MergingIterator::SeekToLast() {
+  forward = false;
+  for (auto &child : children) {
+    child->SeekToLast();
+  }
+  build_heap();
+  find_next();
+}
+
+void MergingIterator::SeekForPrev(int64_t key) {
+  forward = false;
+  for (auto &child : children) {
+    child->SeekForPrev(key);
+  }
+  build_heap();
+  find_next();
+}
+
+void MergingIterator::Next() {
+  if (!forward) {
+    // The children are already past the current key the other way
+    Seek(current_key + 1);
+    return;
+  }
+  find_next();
+}
+
+void MergingIterator::Prev() {
+  if (forward) {
+    SeekForPrev(current_key - 1);
+    return;
+  }
+  find_next();
+}
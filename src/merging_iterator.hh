@@ -0,0 +1,60 @@
+#ifndef MERGING_ITERATOR_HH_
+#define MERGING_ITERATOR_HH_
+
+#include <memory>
+#include <vector>
+
+#include "iterator.hh"
+
+class MergingIterator : public Iterator {
+  /**
+   * Merges the entries of several iterators, ordered from the newest source
+   * (the memtable) to the oldest SST, into one stream in key order.
+   *
+   * The children are kept in a min-heap on (key, age), so each step costs
+   * O(log k) for k children and nothing is buffered. Going backwards the
+   * heap is a max-heap on key instead. Of several versions of
+   * a key only the one from the newest child is returned, and keys whose
+   * newest version is a tombstone are skipped unless keep_tombstones is set.
+   */
+  std::vector<std::unique_ptr<Iterator>> children;  // newest first
+  std::vector<size_t> heap;  // indices of the valid children
+  bool keep_tombstones;
+  bool forward;  // true if the children move in ascending order
+  bool valid;
+  int64_t current_key;
+  int64_t current_value;
+
+  /**
+   * Return true if child a should come after child b.
+   */
+  bool after(size_t a, size_t b) const;
+
+  /**
+   * Rebuild the heap from the valid children.
+   */
+  void build_heap();
+
+  /**
+   * Take the smallest key (the largest when going backwards) off the heap,
+   * moving every child that holds it past it, until a key that is not
+   * deleted is found.
+   */
+  void find_next();
+
+ public:
+  explicit MergingIterator(std::vector<std::unique_ptr<Iterator>> children,
+                           bool keep_tombstones = false);
+
+  void SeekToFirst() override;
+  void Seek(int64_t key) override;
+  void SeekToLast() override;
+  void SeekForPrev(int64_t key) override;
+  bool Valid() const override { return valid; }
+  void Next() override;
+  void Prev() override;
+  int64_t key() const override { return current_key; }
+  int64_t value() const override { return current_value; }
+};
+
+#endif  // MERGING_ITERATOR_HH_
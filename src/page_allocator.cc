@@ -0,0 +1,50 @@
+#include "page_allocator.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include "constants.hh"
+
+using namespace std;
+
+mutex PageAllocator::latch;
+vector<KeyValuePair *> PageAllocator::free_pages;
+
+AlignedPages PageAllocator::allocate_pages(size_t num_pages) {
+  void *memory = nullptr;
+  // posix_memalign may return null for a size of 0, allocate one page instead
+  size_t size = max<size_t>(num_pages, 1) * PAGE_SIZE;
+  if (posix_memalign(&memory, PAGE_SIZE, size) != 0) {
+    throw bad_alloc();
+  }
+  memset(memory, 0, size);
+  return AlignedPages(static_cast<KeyValuePair *>(memory));
+}
+
+KeyValuePair *PageAllocator::allocate_page() {
+  {
+    lock_guard<mutex> guard(latch);
+    if (!free_pages.empty()) {
+      KeyValuePair *page = free_pages.back();
+      free_pages.pop_back();
+      return page;
+    }
+  }
+  void *memory = nullptr;
+  if (posix_memalign(&memory, PAGE_SIZE, PAGE_SIZE) != 0) {
+    throw bad_alloc();
+  }
+  return static_cast<KeyValuePair *>(memory);
+}
+
+void PageAllocator::free_page(KeyValuePair *page) {
+  {
+    lock_guard<mutex> guard(latch);
+    if (free_pages.size() < PAGE_POOL_CAPACITY) {
+      free_pages.push_back(page);
+      return;
+    }
+  }
+  free(page);
+}
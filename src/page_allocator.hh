@@ -0,0 +1,53 @@
+#ifndef PAGE_ALLOCATOR_HH_
+#define PAGE_ALLOCATOR_HH_
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "memtable.hh"
+
+/**
+ * @brief Frees memory from posix_memalign.
+ */
+struct AlignedFree {
+  void operator()(KeyValuePair *pages) const { free(pages); }
+};
+
+/**
+ * Contiguous pages aligned to PAGE_SIZE.
+ */
+typedef std::unique_ptr<KeyValuePair[], AlignedFree> AlignedPages;
+
+class PageAllocator {
+  /**
+   * Hands out pages aligned to PAGE_SIZE, which O_DIRECT reads need. Single
+   * pages given back with free_page are kept on a free list, up to
+   * PAGE_POOL_CAPACITY of them, so private page buffers are not allocated
+   * on every read.
+   */
+  static std::mutex latch;                 // Guards free_pages
+  static std::vector<KeyValuePair *> free_pages;
+
+ public:
+  /**
+   * Return num_pages zeroed pages, one after the other. Throws bad_alloc if
+   * the memory cannot be allocated.
+   */
+  static AlignedPages allocate_pages(size_t num_pages);
+
+  /**
+   * Return a single page, with undefined content. Throws bad_alloc if the
+   * memory cannot be allocated.
+   */
+  static KeyValuePair *allocate_page();
+
+  /**
+   * Give back a page returned by allocate_page.
+   */
+  static void free_page(KeyValuePair *page);
+};
+
+#endif  // PAGE_ALLOCATOR_HH_
@@ -0,0 +1,135 @@
+#include "skiplist.hh"
+
+#include <functional>
+#include <new>
+#include <random>
+#include <thread>
+
+using namespace std;
+
+SkipList::SkipList() : max_height(1), num_entries(0) {
+  head = new_node(0, 0, SKIPLIST_MAX_HEIGHT);
+}
+
+SkipListNode *SkipList::new_node(int64_t key, int64_t value, int height) {
+  size_t bytes =
+      sizeof(SkipListNode) + (height - 1) * sizeof(atomic<SkipListNode *>);
+  SkipListNode *node = reinterpret_cast<SkipListNode *>(arena.allocate(bytes));
+  node->key = key;
+  new (&node->value) atomic<int64_t>(value);
+  node->height = height;
+  for (int level = 0; level < height; level++) {
+    new (&node->next[level]) atomic<SkipListNode *>(nullptr);
+  }
+  return node;
+}
+
+int SkipList::random_height() {
+  // One generator per thread, so concurrent inserts do not share state
+  static thread_local minstd_rand gen(
+      (unsigned)hash<thread::id>()(this_thread::get_id()));
+  int height = 1;
+  while (height < SKIPLIST_MAX_HEIGHT && gen() % SKIPLIST_BRANCHING == 0) {
+    height++;
+  }
+  return height;
+}
+
+void SkipList::find_splice(int64_t key, int level, SkipListNode *&prev,
+                           SkipListNode *&next) {
+  next = prev->next[level].load();
+  while (next != nullptr && next->key < key) {
+    prev = next;
+    next = prev->next[level].load();
+  }
+}
+
+bool SkipList::insert(int64_t key, int64_t value, SkipListNode **splice) {
+  int height = random_height();
+  int list_height = max_height.load();
+  while (height > list_height &&
+         !max_height.compare_exchange_weak(list_height, height)) {
+  }
+
+  // Find the neighbours of key on every level, from the top down
+  SkipListNode *prev[SKIPLIST_MAX_HEIGHT];
+  SkipListNode *next[SKIPLIST_MAX_HEIGHT];
+  SkipListNode *node = head;
+  for (int level = SKIPLIST_MAX_HEIGHT - 1; level >= 0; level--) {
+    // Carry on from the previous insert when it got further on this level
+    if (splice && splice[level] && splice[level] != head &&
+        (node == head || splice[level]->key > node->key)) {
+      node = splice[level];
+    }
+    find_splice(key, level, node, next[level]);
+    prev[level] = node;
+  }
+  if (splice) {
+    for (int level = 0; level < SKIPLIST_MAX_HEIGHT; level++) {
+      splice[level] = prev[level];
+    }
+  }
+  if (next[0] != nullptr && next[0]->key == key) {
+    next[0]->value.store(value);
+    return false;
+  }
+
+  SkipListNode *inserted = new_node(key, value, height);
+  for (int level = 0; level < height; level++) {
+    while (true) {
+      inserted->next[level].store(next[level]);
+      if (prev[level]->next[level].compare_exchange_strong(next[level],
+                                                           inserted)) {
+        break;
+      }
+      // Another thread linked a node after prev, look again from prev
+      find_splice(key, level, prev[level], next[level]);
+      if (level == 0 && next[0] != nullptr && next[0]->key == key) {
+        // The same key was added meanwhile, the node stays unused in the
+        // arena
+        next[0]->value.store(value);
+        return false;
+      }
+    }
+  }
+  num_entries++;
+  return true;
+}
+
+SkipListNode *SkipList::seek(int64_t key) const {
+  SkipListNode *prev = head;
+  SkipListNode *next = nullptr;
+  for (int level = max_height.load() - 1; level >= 0; level--) {
+    find_splice(key, level, prev, next);
+  }
+  return next;
+}
+
+SkipListNode *SkipList::seek_less_than(int64_t key) const {
+  SkipListNode *prev = head;
+  SkipListNode *next = nullptr;
+  for (int level = max_height.load() - 1; level >= 0; level--) {
+    find_splice(key, level, prev, next);
+  }
+  return prev == head ? nullptr : prev;
+}
+
+SkipListNode *SkipList::last() const {
+  SkipListNode *node = head;
+  for (int level = max_height.load() - 1; level >= 0; level--) {
+    for (SkipListNode *next = node->next[level].load(); next != nullptr;
+         next = node->next[level].load()) {
+      node = next;
+    }
+  }
+  return node == head ? nullptr : node;
+}
+
+bool SkipList::get(int64_t key, int64_t &value) const {
+  SkipListNode *node = seek(key);
+  if (node == nullptr || node->key != key) {
+    return false;
+  }
+  value = node->value.load();
+  return true;
+}
@@ -0,0 +1,111 @@
+#ifndef SKIPLIST_HH_
+#define SKIPLIST_HH_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "arena.hh"
+#include "constants.hh"
+
+/**
+ * @brief Node of a SkipList, allocated from the arena of the list with
+ * height next pointers instead of one.
+ */
+struct SkipListNode {
+  int64_t key;
+  std::atomic<int64_t> value;
+  int height;
+  std::atomic<SkipListNode *> next[1];  // height pointers, lowest level first
+};
+
+class SkipList {
+  /**
+   * Sorted map of keys to values used as a memtable.
+   *
+   * Nodes are bump-allocated from the arena of the list and never freed one
+   * by one, the whole list is released at once when it is destroyed.
+   * Inserts link a node one level at a time with a compare-and-swap,
+   * starting from the bottom, so several threads may insert at once without
+   * a lock. Readers only follow next pointers and never wait. A node is in
+   * the list once it is linked at the bottom level, the upper levels only
+   * make searches faster.
+   */
+  Arena arena;
+  SkipListNode *head;              // SKIPLIST_MAX_HEIGHT high, no key
+  std::atomic<int> max_height;     // height of the tallest node
+  std::atomic<size_t> num_entries;  // number of distinct keys
+
+  /**
+   * Return a new node of the given height from the arena.
+   */
+  SkipListNode *new_node(int64_t key, int64_t value, int height);
+
+  /**
+   * Return a random height between 1 and SKIPLIST_MAX_HEIGHT, each level
+   * being 1 in SKIPLIST_BRANCHING times less likely than the one below.
+   */
+  static int random_height();
+
+  /**
+   * Starting at prev on the given level, set prev to the last node with a
+   * key < key and next to the node after it.
+   */
+  static void find_splice(int64_t key, int level, SkipListNode *&prev,
+                          SkipListNode *&next);
+
+ public:
+  SkipList();
+
+  SkipList(const SkipList &) = delete;
+  SkipList &operator=(const SkipList &) = delete;
+
+  /**
+   * Set the value of key, adding key if it is not in the list. Return true
+   * if key was added. Safe to call from several threads.
+   *
+   * splice, if given, is an array of SKIPLIST_MAX_HEIGHT nodes (initially
+   * null) that is set to the neighbours of key on every level. Passed back
+   * to the insert of a larger key, the search picks up from there, so keys
+   * inserted in ascending order do not search the list from the head.
+   */
+  bool insert(int64_t key, int64_t value, SkipListNode **splice = nullptr);
+
+  /**
+   * Set value to the value of key and return true, or return false if key
+   * is not in the list.
+   */
+  bool get(int64_t key, int64_t &value) const;
+
+  /**
+   * Return the first node with a key >= key, or null.
+   */
+  SkipListNode *seek(int64_t key) const;
+
+  /**
+   * Return the last node with a key < key, or null.
+   */
+  SkipListNode *seek_less_than(int64_t key) const;
+
+  /**
+   * Return the first node, or null if the list is empty.
+   */
+  SkipListNode *first() const { return head->next[0].load(); }
+
+  /**
+   * Return the last node, or null if the list is empty.
+   */
+  SkipListNode *last() const;
+
+  /**
+   * Return the number of keys in the list.
+   */
+  size_t size() const { return num_entries.load(); }
+
+  /**
+   * Return the number of bytes held by the arena of the list.
+   */
+  size_t get_memory_usage() const { return arena.get_memory_usage(); }
+};
+
+#endif  // SKIPLIST_HH_
@@ -0,0 +1,62 @@
+#include "table_reader.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <stdexcept>
+
+using namespace std;
+
+TableReader::TableReader(const string &path, const string &file_name,
+                         uint32_t file_number, bool use_mmap)
+    : path(path),
+      file_name(file_name),
+      file_number(file_number),
+      fd(-1),
+      file_size(0),
+      mapping(nullptr),
+      metadata(),
+      filter(nullptr),
+      filter_bytes(0),
+      min_key(0),
+      max_key(0) {
+  fd = open(path.c_str(), use_mmap ? O_RDONLY : O_RDONLY | O_DIRECT);
+  if (fd == -1) {
+    perror("Failed to open the file");
+    throw runtime_error("Failed to open SST file: " + path);
+  }
+
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == 0) {
+    file_size = stat_buf.st_size;
+  }
+
+  if (use_mmap && file_size > 0) {
+    void *addr = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      perror("Failed to map the file");
+      close(fd);
+      throw runtime_error("Failed to map SST file: " + path);
+    }
+    mapping = static_cast<const char *>(addr);
+  }
+}
+
+TableReader::~TableReader() {
+  if (mapping && munmap(const_cast<char *>(mapping), file_size) == -1) {
+    perror("Error unmapping file in TableReader");
+  }
+  if (fd != -1 && close(fd) == -1) {
+    perror("Error closing file in TableReader");
+  }
+}
+
+bool TableReader::overlaps(int64_t key1, int64_t key2) const {
+  if (min_key == 0 && max_key == 0) {
+    return true;
+  }
+  return key1 <= max_key && key2 >= min_key;
+}
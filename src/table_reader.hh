@@ -0,0 +1,93 @@
+#ifndef TABLE_READER_HH_
+#define TABLE_READER_HH_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bloom-filter.hh"
+
+struct BSSTMetadata {
+  int64_t entries_offset;
+  int64_t filter_offset;
+  int64_t seeds_offset;
+  int64_t bits_per_entry;
+  int64_t num_entries;
+  int64_t filter_length;
+  int64_t num_seeds;
+  int64_t file_size;
+  int64_t min_key;  // smallest key in the SST, 0 if not recorded
+  int64_t max_key;  // largest key in the SST, 0 if not recorded
+  int64_t filter_type;  // STANDARD_BLOOM_FILTER (0, also in older SSTs) or
+                        // BLOCKED_BLOOM_FILTER
+  int64_t summaries_offset;  // offset of the leaf summaries, 0 if none
+  int64_t filter_entries;  // number of entries the Bloom filter is sized for,
+                           // num_entries in SSTs that do not record it
+};
+
+/**
+ * @brief Summary of one leaf of a BSST, stored after the Bloom filter seeds
+ * so range aggregates can count whole leaves without reading them.
+ */
+struct LeafSummary {
+  int64_t first_key;  // key of the first entry, tombstones included
+  int64_t last_key;   // key of the last entry, tombstones included
+  int64_t count;      // number of entries that are not tombstones
+  int64_t sum;        // sum of their values
+  int64_t min;        // smallest of their values, 0 if count is 0
+  int64_t max;        // largest of their values, 0 if count is 0
+};
+
+/**
+ * @brief Open handle on a single SST.
+ *
+ * A TableReader is created when an SST is registered with the database and
+ * lives for as long as the SST is listed in Database::ssts, so Get and Scan
+ * never have to open()/close() the file or rebuild its path. For B-tree SSTs
+ * the parsed metadata page and the Bloom filter are kept here as well.
+ */
+struct TableReader {
+  const std::string path;       // path to the SST, including database dir
+  const std::string file_name;  // name of the SST without ".bin"
+  const uint32_t file_number;   // number of the SST in bufferpool page IDs
+  int fd;                       // descriptor opened with O_RDONLY | O_DIRECT
+  int64_t file_size;            // size of the SST in bytes
+  const char *mapping;          // whole SST mapped read-only, or null
+  BSSTMetadata metadata;        // metadata page of a BSST
+  std::unique_ptr<BloomFilter> filter;  // resident Bloom filter, if any
+  size_t filter_bytes;  // memory charged to the filter cache budget
+  int64_t min_key;      // smallest key in the SST, 0 if unknown
+  int64_t max_key;      // largest key in the SST, 0 if unknown
+  // Summary of each leaf in file order, loaded on first use
+  std::vector<LeafSummary> leaf_summaries;
+
+  /**
+   * @brief Open the SST at path for reading.
+   *
+   * @param path path to the SST file
+   * @param file_name name of the SST without extension
+   * @param file_number number assigned to the SST when it was registered,
+   * used in bufferpool page IDs
+   * @param use_mmap if true, open without O_DIRECT and map the whole SST so
+   * pages are read in place from the OS page cache
+   */
+  TableReader(const std::string &path, const std::string &file_name,
+              uint32_t file_number, bool use_mmap = false);
+
+  /**
+   * @brief Unmap and close the descriptor of the SST.
+   */
+  ~TableReader();
+
+  /**
+   * @brief Return false if [key1, key2] does not overlap the key range of the
+   * SST. SSTs whose key range is unknown always overlap.
+   */
+  bool overlaps(int64_t key1, int64_t key2) const;
+
+  TableReader(const TableReader &) = delete;
+  TableReader &operator=(const TableReader &) = delete;
+};
+
+#endif  // TABLE_READER_HH_
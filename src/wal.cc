@@ -0,0 +1,159 @@
+#include "wal.hh"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+
+WriteAheadLog::WriteAheadLog(const string &path, const string &sync_policy,
+                             int sync_interval_ms)
+    : path(path),
+      sync_policy(sync_policy),
+      sync_interval(sync_interval_ms),
+      last_sync(chrono::steady_clock::now()),
+      unsynced(false),
+      stop_syncing(false) {
+  if (sync_policy != WAL_SYNC_ALWAYS && sync_policy != WAL_SYNC_INTERVAL &&
+      sync_policy != WAL_SYNC_NONE) {
+    throw invalid_argument("Unknown WAL sync policy: " + sync_policy);
+  }
+  fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    throw runtime_error("Could not open WAL " + path + ": " + strerror(errno));
+  }
+  if (sync_policy == WAL_SYNC_INTERVAL) {
+    sync_thread = thread(&WriteAheadLog::sync_periodically, this);
+  }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+  if (sync_thread.joinable()) {
+    {
+      lock_guard<mutex> guard(sync_latch);
+      stop_syncing = true;
+    }
+    sync_wakeup.notify_all();
+    sync_thread.join();
+  }
+  if (sync_policy != WAL_SYNC_NONE) {
+    sync();
+  }
+  close(fd);
+}
+
+uint32_t WriteAheadLog::checksum(const KeyValuePair *pairs, size_t count) {
+  // FNV-1a over the bytes of the pairs
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(pairs);
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < count * sizeof(KeyValuePair); i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+void WriteAheadLog::encode(const KeyValuePair *pairs, size_t count,
+                           vector<char> &buffer) {
+  uint32_t header[2] = {(uint32_t)count, checksum(pairs, count)};
+  const char *header_bytes = reinterpret_cast<const char *>(header);
+  const char *pair_bytes = reinterpret_cast<const char *>(pairs);
+  buffer.insert(buffer.end(), header_bytes, header_bytes + sizeof(header));
+  buffer.insert(buffer.end(), pair_bytes,
+                pair_bytes + count * sizeof(KeyValuePair));
+}
+
+void WriteAheadLog::append(const vector<char> &buffer) {
+  size_t written = 0;
+  while (written < buffer.size()) {
+    ssize_t rc = write(fd, buffer.data() + written, buffer.size() - written);
+    if (rc < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw runtime_error("Could not write WAL " + path + ": " +
+                          strerror(errno));
+    }
+    written += rc;
+  }
+
+  bool overdue;
+  {
+    lock_guard<mutex> guard(sync_latch);
+    unsynced = true;
+    overdue = chrono::steady_clock::now() - last_sync >= sync_interval;
+  }
+  if (sync_policy == WAL_SYNC_ALWAYS ||
+      (sync_policy == WAL_SYNC_INTERVAL && overdue)) {
+    sync();
+  }
+}
+
+void WriteAheadLog::sync() {
+  {
+    // Appends made while syncing are left for the next sync
+    lock_guard<mutex> guard(sync_latch);
+    unsynced = false;
+    last_sync = chrono::steady_clock::now();
+  }
+  if (fdatasync(fd) != 0) {
+    throw runtime_error("Could not sync WAL " + path + ": " + strerror(errno));
+  }
+}
+
+void WriteAheadLog::sync_periodically() {
+  unique_lock<mutex> lock(sync_latch);
+  while (!sync_wakeup.wait_for(lock, sync_interval,
+                               [this] { return stop_syncing; })) {
+    if (!unsynced) {
+      continue;
+    }
+    lock.unlock();
+    try {
+      sync();
+    } catch (const runtime_error &e) {
+      cerr << e.what() << "\n";
+    }
+    lock.lock();
+  }
+}
+
+void WriteAheadLog::truncate() {
+  if (ftruncate(fd, 0) != 0) {
+    throw runtime_error("Could not truncate WAL " + path + ": " +
+                        strerror(errno));
+  }
+  if (sync_policy != WAL_SYNC_NONE) {
+    sync();
+  }
+}
+
+vector<vector<KeyValuePair>> WriteAheadLog::read(const string &path) {
+  ifstream inFile(path, ios::binary);
+  vector<char> data((istreambuf_iterator<char>(inFile)),
+                    istreambuf_iterator<char>());
+
+  vector<vector<KeyValuePair>> writes;
+  size_t offset = 0;
+  uint32_t header[2];
+  while (offset + sizeof(header) <= data.size()) {
+    memcpy(header, data.data() + offset, sizeof(header));
+    size_t size = (size_t)header[0] * sizeof(KeyValuePair);
+    if (header[0] == 0 || size > data.size() - offset - sizeof(header)) {
+      break;  // Cut short by a crash
+    }
+    vector<KeyValuePair> pairs(header[0]);
+    memcpy(pairs.data(), data.data() + offset + sizeof(header), size);
+    if (checksum(pairs.data(), pairs.size()) != header[1]) {
+      break;
+    }
+    writes.push_back(pairs);
+    offset += sizeof(header) + size;
+  }
+  return writes;
+}
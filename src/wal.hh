@@ -0,0 +1,99 @@
+#ifndef WAL_HH_
+#define WAL_HH_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "constants.hh"
+#include "memtable.hh"
+
+class WriteAheadLog {
+  /**
+   * Log of the writes applied to the memtable, replayed by Database::Open
+   * so writes that were not flushed to an SST survive a crash.
+   *
+   * The log is a sequence of records, each holding the KV-pairs of one
+   * write: a 32-bit count, a 32-bit checksum of the pairs, then the pairs.
+   * Records are appended with O_APPEND and synced according to the sync
+   * policy. A record cut short by a crash, or whose checksum does not
+   * match, ends the log, so a write is replayed whole or not at all.
+   *
+   * With WAL_SYNC_INTERVAL a sync thread also syncs appends left unsynced
+   * for sync_interval, so writes followed by no other are not lost either.
+   */
+  int fd;
+  std::string path;
+  std::string sync_policy;  // WAL_SYNC_ALWAYS, WAL_SYNC_INTERVAL, WAL_SYNC_NONE
+  std::chrono::milliseconds sync_interval;
+  std::chrono::steady_clock::time_point last_sync;
+  bool unsynced;  // true if an append was not synced yet
+
+  std::thread sync_thread;
+  std::mutex sync_latch;  // protects last_sync, unsynced and stop_syncing
+  std::condition_variable sync_wakeup;
+  bool stop_syncing;
+
+  /**
+   * Body of the sync thread: every sync_interval, sync the log if an append
+   * is unsynced, until the log is closed.
+   */
+  void sync_periodically();
+
+  /**
+   * Return the checksum of count pairs.
+   */
+  static uint32_t checksum(const KeyValuePair *pairs, size_t count);
+
+ public:
+  /**
+   * Create the log file path, or open it to append to it if it exists.
+   * With WAL_SYNC_ALWAYS every append is synced before it returns, with
+   * WAL_SYNC_INTERVAL an append is synced at most sync_interval_ms later,
+   * and with WAL_SYNC_NONE the log is only written to the OS, which keeps it
+   * across a crash of the process but not of the machine. Throws
+   * invalid_argument for any other policy.
+   */
+  WriteAheadLog(const std::string &path, const std::string &sync_policy,
+                int sync_interval_ms = WAL_SYNC_INTERVAL_MS);
+  ~WriteAheadLog();
+
+  WriteAheadLog(const WriteAheadLog &) = delete;
+  WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+  /**
+   * Append a record holding count pairs to buffer.
+   */
+  static void encode(const KeyValuePair *pairs, size_t count,
+                     std::vector<char> &buffer);
+
+  /**
+   * Write buffer, a sequence of records built with encode, to the log with
+   * a single write and sync it according to the sync policy.
+   */
+  void append(const std::vector<char> &buffer);
+
+  /**
+   * Flush the log to disk.
+   */
+  void sync();
+
+  /**
+   * Drop every record of the log, once their writes are in an SST.
+   */
+  void truncate();
+
+  const std::string &get_path() const { return path; }
+
+  /**
+   * Return the writes recorded in the log file path, oldest first, up to
+   * the first record that is incomplete or corrupt.
+   */
+  static std::vector<std::vector<KeyValuePair>> read(const std::string &path);
+};
+
+#endif  // WAL_HH_
@@ -0,0 +1,47 @@
+#ifndef WRITE_BATCH_HH_
+#define WRITE_BATCH_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "memtable.hh"
+
+class WriteBatch {
+  /**
+   * Puts and deletes applied together by Database::Write. The writes are
+   * kept in the order they were added, so a later write of a key replaces
+   * an earlier one of the same batch.
+   */
+  std::vector<KeyValuePair> pairs;
+
+ public:
+  /**
+   * Store value for key when the batch is written.
+   */
+  void Put(const int64_t &key, const int64_t &value) {
+    pairs.push_back(KeyValuePair{key, value});
+  }
+
+  /**
+   * Delete key when the batch is written.
+   */
+  void Delete(const int64_t &key) { Put(key, 0); }
+
+  /**
+   * Remove every write from the batch.
+   */
+  void Clear() { pairs.clear(); }
+
+  /**
+   * Return the number of writes in the batch.
+   */
+  size_t Count() const { return pairs.size(); }
+
+  /**
+   * Return the writes of the batch, in the order they were added.
+   */
+  const std::vector<KeyValuePair> &get_pairs() const { return pairs; }
+};
+
+#endif  // WRITE_BATCH_HH_
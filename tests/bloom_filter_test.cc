@@ -104,6 +104,44 @@ bool testConstructor() {
   return true;
 }
 
+bool testBlockedFilter() {
+  int num_entries = 1000;
+  BloomFilter test_filter(num_entries, 10, BLOCKED_BLOOM_FILTER);
+  // Whole 64-byte blocks and a single seed
+  if (test_filter.get_filter_size() % BLOOM_BLOCK_WORDS != 0 ||
+      test_filter.get_seeds().size() != 1) {
+    return false;
+  }
+
+  for (int i = 0; i < num_entries; i++) {
+    test_filter.insert(i + 1);
+  }
+
+  BloomFilter second_constructor(
+      test_filter.get_filter(), test_filter.get_num_entries(),
+      test_filter.get_bits_per_entry(), test_filter.get_seeds(),
+      BLOCKED_BLOOM_FILTER);
+  if (second_constructor.get_num_hash_functions() !=
+      test_filter.get_num_hash_functions()) {
+    return false;
+  }
+
+  for (int i = 0; i < num_entries; i++) {
+    if (!second_constructor.includes(i + 1)) {
+      return false;
+    }
+  }
+
+  // At 10 bits per entry the false positive rate should stay around 1%
+  int false_positives = 0;
+  for (int i = 0; i < 10000; i++) {
+    if (second_constructor.includes(num_entries + i + 1)) {
+      false_positives += 1;
+    }
+  }
+  return false_positives < 500;
+}
+
 bool runBloomFilterTests() {
   int tests_passed = 0;
   int num_tests = 0;
@@ -144,6 +182,15 @@ bool runBloomFilterTests() {
   }
   num_tests += 1;
 
+  cout << "Running testBlockedFilter\n";
+  if (testBlockedFilter()) {
+    cout << "testBlockedFilter passed.\n";
+    tests_passed += 1;
+  } else {
+    cout << "testBlockedFilter failed.\n";
+  }
+  num_tests += 1;
+
   cout << "\nTotal of " << tests_passed << "/" << num_tests
        << " passed in BLOOM FILTER TESTS\n";
   return tests_passed == num_tests;
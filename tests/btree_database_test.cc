@@ -3,6 +3,11 @@
 //
 #include "btree_database_test.hh"
 
+#include <dirent.h>
+
+#include <fstream>
+#include <thread>
+
 #include "database_test.hh"
 
 bool testGetAndPut(Database &database) {
@@ -84,6 +89,259 @@ bool testScan(Database &database) {
   return true;
 }
 
+bool testNarrowScans(Database &database) {
+  // Scans stop at key2 instead of reading to the end of each SST, with and
+  // without leaves read ahead asynchronously
+  int64_t ranges[][2] = {{100, 110}, {65530, 65545},   {255, 257},
+                         {1, 2},     {131070, 200000}, {131073, 131080}};
+  for (bool async_io : {false, true}) {
+    database.set_async_io_enabled(async_io);
+    for (auto &range : ranges) {
+      ScanResponse scan = database.Scan(range[0], range[1]);
+      int64_t expected_size =
+          max<int64_t>(0, min<int64_t>(range[1], 131072) - range[0] + 1);
+      if (scan.size != expected_size) {
+        database.set_async_io_enabled(false);
+        return false;
+      }
+      for (int i = 0; i < scan.size; i++) {
+        if (scan.result[i].key != range[0] + i ||
+            scan.result[i].value != range[0] + i) {
+          database.set_async_io_enabled(false);
+          return false;
+        }
+      }
+    }
+  }
+  database.set_async_io_enabled(false);
+  return true;
+}
+
+bool testReverseScans(Database &database) {
+  // The same ranges as testNarrowScans read backwards, and the latest keys
+  // below a bound
+  int64_t ranges[][2] = {{100, 110}, {65530, 65545},   {255, 257},
+                         {1, 2},     {131070, 200000}, {131073, 131080}};
+  for (bool async_io : {false, true}) {
+    database.set_async_io_enabled(async_io);
+    for (auto &range : ranges) {
+      ScanResponse scan = database.ReverseScan(range[0], range[1]);
+      int64_t last = min<int64_t>(range[1], 131072);
+      if (scan.size != max<int64_t>(0, last - range[0] + 1)) {
+        database.set_async_io_enabled(false);
+        return false;
+      }
+      for (int i = 0; i < scan.size; i++) {
+        if (scan.result[i].key != last - i ||
+            scan.result[i].value != last - i) {
+          database.set_async_io_enabled(false);
+          return false;
+        }
+      }
+    }
+  }
+  database.set_async_io_enabled(false);
+
+  ScanResponse latest = database.ReverseScan(1, 65537, 3);
+  return latest.size == 3 && latest.result[0].key == 65537 &&
+         latest.result[2].key == 65535;
+}
+
+bool testMultiGet(Database &database) {
+  // Shadow one key and delete another in the memtable
+  database.Put(5, 555);
+  database.Delete(7);
+
+  vector<int64_t> keys = {131072, 5, 7, 1, 65537, 0, -3, 200000, 5, 70000};
+  vector<int64_t> expected = {131072, 555, -1, 1, 65537, -1, -1, -1, 555, 70000};
+  vector<int64_t> values = database.MultiGet(keys);
+  if (values != expected) {
+    return false;
+  }
+
+  // A large batch spanning both SSTs must agree with Get
+  vector<int64_t> batch;
+  for (int64_t key = 3; key <= 140000; key += 97) {
+    batch.push_back(key);
+  }
+  values = database.MultiGet(batch);
+  for (size_t i = 0; i < batch.size(); i++) {
+    if (values[i] != database.Get(batch[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool testAggregate(Database &database) {
+  // Whole leaves come from summaries, the memtable still shadows key 5 and
+  // deletes key 7
+  int64_t last = 131072;
+  if (database.Aggregate(1, last, AGGREGATE_COUNT) != last - 1 ||
+      database.Aggregate(1, last, AGGREGATE_SUM) !=
+          last * (last + 1) / 2 - 5 + 555 - 7) {
+    return false;
+  }
+  if (database.Aggregate(1, 10, AGGREGATE_MIN) != 1 ||
+      database.Aggregate(1, 10, AGGREGATE_MAX) != 555) {
+    return false;
+  }
+
+  // Partial leaves at both ends of a range spanning both SSTs
+  ScanResponse scan = database.Scan(100, 65600);
+  int64_t sum = 0;
+  for (auto &pair : scan.result) {
+    sum += pair.value;
+  }
+  if (database.Aggregate(100, 65600, AGGREGATE_COUNT) != scan.size ||
+      database.Aggregate(100, 65600, AGGREGATE_SUM) != sum ||
+      database.Aggregate(100, 65600, AGGREGATE_MAX) != 65600) {
+    return false;
+  }
+
+  return database.Aggregate(200000, 300000, AGGREGATE_COUNT) == 0 &&
+         database.Aggregate(200000, 300000, AGGREGATE_MIN) == -1;
+}
+
+bool testAsyncIO(Database &database) {
+  // Batched asynchronous reads must return the same values as pread
+  vector<int64_t> batch;
+  for (int64_t key = 1; key <= 140000; key += 61) {
+    batch.push_back(key);
+  }
+  vector<int64_t> expected = database.MultiGet(batch);
+
+  database.set_async_io_enabled(true);
+  vector<int64_t> values = database.MultiGet(batch);
+  bool error_found = values != expected;
+  for (size_t i = 0; i < batch.size() && !error_found; i++) {
+    if (database.Get(batch[i]) != expected[i]) {
+      error_found = true;
+    }
+  }
+  database.set_async_io_enabled(false);
+  return !error_found;
+}
+
+bool testWALRecovery(const string &dir_path,
+                     const string &database_type = BSST) {
+  // Writes still in the memtable survive a database that is never closed
+  deleteAllFilesInDirectory(dir_path);
+  {
+    Database database(100, 10);
+    database.set_wal_enabled(true);
+    database.Open(dir_path, database_type);
+    for (int64_t key = 1; key <= 250; key++) {
+      database.Put(key, key + 7);
+    }
+    database.Delete(3);
+    database.Put(240, 1);
+  }
+
+  // A record cut short by the crash is ignored
+  DIR *dir = opendir(dir_path.c_str());
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    if (string(entry->d_name).find(".log") != string::npos) {
+      ofstream log(dir_path + "/" + entry->d_name, ios::binary | ios::app);
+      log.write("\x05\0\0\0torn", 8);
+    }
+  }
+  closedir(dir);
+  // So is an SST the crash left half flushed
+  string partial_flush = dir_path + "/MEMTABLE_0.tmp";
+  ofstream(partial_flush, ios::binary).write("partial", 7);
+
+  Database database(100, 10);
+  database.Open(dir_path, database_type);
+  bool passed = !ifstream(partial_flush) && database.Get(3) == -1 &&
+                database.Get(240) == 1;
+  for (int64_t key = 4; passed && key <= 250; key++) {
+    passed = key == 240 || database.Get(key) == key + 7;
+  }
+  database.Close();
+  return passed;
+}
+
+bool testGroupCommit(const string &dir_path) {
+  // Threads writing at once share WAL appends, including while full
+  // memtables are handed to the flush thread
+  deleteAllFilesInDirectory(dir_path);
+  int num_threads = 4;
+  int64_t keys_per_thread = 500;
+  {
+    Database database(300, 10);
+    database.set_wal_enabled(true);
+    database.set_background_flush(true);
+    database.Open(dir_path, BSST);
+    vector<thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+      threads.emplace_back([&database, t, keys_per_thread]() {
+        for (int64_t i = 1; i <= keys_per_thread; i++) {
+          database.Put(t * keys_per_thread + i, i);
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+  }
+
+  Database database(300, 10);
+  database.Open(dir_path, BSST);
+  bool passed = true;
+  for (int64_t key = 1; passed && key <= num_threads * keys_per_thread;
+       key++) {
+    passed = database.Get(key) == (key - 1) % keys_per_thread + 1;
+  }
+  database.Close();
+  return passed;
+}
+
+bool testWriteBatch(const string &dir_path) {
+  // A batch larger than the memtable is applied whole and flushed once,
+  // and a logged batch is replayed whole
+  deleteAllFilesInDirectory(dir_path);
+  bool passed = true;
+  {
+    Database database(100, 10);
+    database.set_wal_enabled(true);
+    database.Open(dir_path, BSST);
+    WriteBatch batch;
+    for (int64_t key = 300; key >= 1; key--) {
+      batch.Put(key, key);
+    }
+    batch.Put(7, 70);
+    batch.Delete(8);
+    database.Write(batch);
+    int64_t num_ssts = 0;
+    DIR *dir = opendir(dir_path.c_str());
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+      num_ssts += string(entry->d_name).find(".bin") != string::npos;
+    }
+    closedir(dir);
+    passed = num_ssts == 1 && database.Get(7) == 70 &&
+             database.Get(8) == -1 && database.Get(300) == 300;
+
+    batch.Clear();
+    for (int64_t key = 301; key <= 350; key++) {
+      batch.Put(key, key * 2);
+    }
+    batch.Delete(1);
+    database.Write(batch);
+  }
+
+  Database database(100, 10);
+  database.Open(dir_path, BSST);
+  passed = passed && database.Get(1) == -1 && database.Get(2) == 2;
+  for (int64_t key = 301; passed && key <= 350; key++) {
+    passed = database.Get(key) == key * 2;
+  }
+  database.Close();
+  return passed;
+}
+
 bool runBTreeDatabaseTests() {
   deleteAllFilesInDirectory("tests/ssts/btree_database_test");
 
@@ -131,6 +389,87 @@ bool runBTreeDatabaseTests() {
   }
   num_tests += 1;
 
+  cout << "Running testNarrowScans\n";
+  if (testNarrowScans(database)) {
+    cout << "testNarrowScans passed.\n";
+    tests_passed += 1;
+  } else {
+    cout << "testNarrowScans failed.\n";
+  }
+  num_tests += 1;
+
+  cout << "Running testReverseScans\n";
+  if (testReverseScans(database)) {
+    cout << "testReverseScans passed.\n";
+    tests_passed += 1;
+  } else {
+    cout << "testReverseScans failed.\n";
+  }
+  num_tests += 1;
+
+  cout << "Running testMultiGet\n";
+  if (testMultiGet(database)) {
+    cout << "testMultiGet passed.\n";
+    tests_passed += 1;
+  } else {
+    cout << "testMultiGet failed.\n";
+  }
+  num_tests += 1;
+
+  cout << "Running testAggregate\n";
+  if (testAggregate(database)) {
+    cout << "testAggregate passed.\n";
+    tests_passed += 1;
+  } else {
+    cout << "testAggregate failed.\n";
+  }
+  num_tests += 1;
+
+  cout << "Running testAsyncIO\n";
+  if (testAsyncIO(database)) {
+    cout << "testAsyncIO passed.\n";
+    tests_passed += 1;
+  } else {
+    cout << "testAsyncIO failed.\n";
+  }
+  num_tests += 1;
+
+  cout << "Running testWALRecovery\n";
+  if (testWALRecovery("tests/ssts/btree_database_test/wal")) {
+    cout << "testWALRecovery passed.\n";
+    tests_passed += 1;
+  } else {
+    cout << "testWALRecovery failed.\n";
+  }
+  num_tests += 1;
+
+  cout << "Running testWALRecovery on an LSM tree\n";
+  if (testWALRecovery("tests/ssts/btree_database_test/wal", LSM_TREE)) {
+    cout << "testWALRecovery on an LSM tree passed.\n";
+    tests_passed += 1;
+  } else {
+    cout << "testWALRecovery on an LSM tree failed.\n";
+  }
+  num_tests += 1;
+
+  cout << "Running testGroupCommit\n";
+  if (testGroupCommit("tests/ssts/btree_database_test/wal")) {
+    cout << "testGroupCommit passed.\n";
+    tests_passed += 1;
+  } else {
+    cout << "testGroupCommit failed.\n";
+  }
+  num_tests += 1;
+
+  cout << "Running testWriteBatch\n";
+  if (testWriteBatch("tests/ssts/btree_database_test/wal")) {
+    cout << "testWriteBatch passed.\n";
+    tests_passed += 1;
+  } else {
+    cout << "testWriteBatch failed.\n";
+  }
+  num_tests += 1;
+
   cout << "\nTotal of " << tests_passed << "/" << num_tests
        << " passed in BTREE_DATABASE TESTS\n";
   return tests_passed == num_tests;
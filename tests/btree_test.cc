@@ -2,329 +2,116 @@
 // Created by Sam Hui on 2023-11-20.
 //
 
-#include "../src/btree.hh"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
 
-#include <cmath>
-#include <queue>
-
-#include "../src/memtable.hh"
+#include "../src/bsst_builder.hh"
 #include "btree_test.hh"
 
-bool testRootLeaf(int num_entries) {
-  Memtable memtable(num_entries + 1);
+using namespace std;
 
+const string BTREE_TEST_PATH = "tests/ssts/btree_test.bin";
+
+// Write a BSST of keys 1 to num_entries, each the value of its key, with
+// room for max_entries
+void writeBTree(int num_entries, int max_entries) {
+  BSSTBuilder builder(BTREE_TEST_PATH, max_entries, 10, STANDARD_BLOOM_FILTER);
   for (int64_t i = 1; i < num_entries + 1; i++) {
-    memtable.put(i, i);
+    builder.add(i, i);
   }
+  builder.finish();
+}
 
-  std::vector<BTreePair*> kv_pairs;
-  memtable.traverse(kv_pairs);
-
-  queue<BTreeNode*> leaf_nodes;
-  BTreeNode* curr_leaf = new BTreeNode();
+void writeBTree(int num_entries) { writeBTree(num_entries, num_entries); }
 
-  for (int64_t i = 0; i < num_entries; i++) {
-    curr_leaf->insert(kv_pairs[i]);
-    if (curr_leaf->get_size() >= 256) {
-      leaf_nodes.push(curr_leaf);
-      curr_leaf = new BTreeNode();
-    }
-  }
+// Read the page at offset of the BSST as key, value, key, value...
+vector<int64_t> readPage(int64_t offset) {
+  vector<int64_t> page(2 * PAGE_NUM_ENTRIES, 0);
+  ifstream inFile(BTREE_TEST_PATH, ios::binary);
+  inFile.seekg(offset);
+  inFile.read(reinterpret_cast<char*>(page.data()), PAGE_SIZE);
+  return page;
+}
 
-  if (curr_leaf->get_size() > 0) {
-    leaf_nodes.push(curr_leaf);
+// Return the number of entries of a page, padding excluded
+int pageSize(const vector<int64_t>& page) {
+  int size = 0;
+  while (size < PAGE_NUM_ENTRIES && page[2 * size] != 0) {
+    size++;
   }
+  return size;
+}
 
-  BTreeNode* root_node = nullptr;
-
-  if (leaf_nodes.size() == 1) {
-    // There are 256 entries or fewer being flushed
-    // The leaf itself can be the root node
-    root_node = leaf_nodes.front();
-  } else {
-    // There are more than 256 entries being flushed
-    // Thus we have at least two leaf nodes that should be referenced by a
-    // parent
-    bool root_ready = false;
-    queue<BTreeNode*> internal_nodes;
-
-    while (!root_ready) {
-      int num_leaves = leaf_nodes.size();
-      BTreeNode* curr_node = new BTreeNode();
-      int num_internal = std::ceil(static_cast<double>(num_leaves) / 256);
-      int base_distribution = num_leaves / num_internal;
-      int num_extras = num_leaves % num_internal;
-
-      while (num_leaves > 0) {
-        BTreeNode* leaf = leaf_nodes.front();
-        leaf_nodes.pop();
-        curr_node->insert(leaf);
-        num_leaves--;
-        if (num_extras > 0 &&
-            curr_node->get_size() == (base_distribution + 1)) {
-          num_extras--;
-          internal_nodes.push(curr_node);
-          curr_node = new BTreeNode();
-        } else if (num_extras == 0 &&
-                   curr_node->get_size() == base_distribution) {
-          internal_nodes.push(curr_node);
-          curr_node = new BTreeNode();
-        }
-      }
-
-      if (internal_nodes.size() <= 256) {
-        root_ready = true;
-      } else {
-        leaf_nodes = internal_nodes;
-        std::queue<BTreeNode*> empty;
-        std::swap(empty, internal_nodes);
-      }
-    }
+bool testRootLeaf(int num_entries) {
+  writeBTree(num_entries);
 
-    if (internal_nodes.size() == 1) {
-      // There is only one internal node left, make it the root
-      root_node = internal_nodes.front();
-    } else {
-      // There are less than 256 internal nodes, thus we insert them all into
-      // a parent node and return the parent node
-      root_node = new BTreeNode();
-      // Insert all nodes in internal_nodes to root_node
-      while (!internal_nodes.empty()) {
-        root_node->insert(internal_nodes.front());
-        internal_nodes.pop();
-      }
-    }
-  }
-  bool result = (root_node->get_size() == 256) &&
-                (!root_node->get_entries()[0]->isBTreeNode());
-  EntryBase::clearBTree(root_node);
-  root_node = nullptr;
+  // The root is on page 1 and is the only leaf
+  int64_t entries_offset = readPage(0)[0];
+  vector<int64_t> root_node = readPage(PAGE_SIZE);
+  bool result = entries_offset == PAGE_SIZE && pageSize(root_node) == 256 &&
+                root_node[0] == 1 && root_node[1] == 1 &&
+                root_node[2 * 255] == 256;
+  remove(BTREE_TEST_PATH.c_str());
 
   return result;
 }
 
 bool testHeightOne(int num_entries) {
-  Memtable memtable(num_entries + 1);
-
-  for (int64_t i = 1; i < num_entries + 1; i++) {
-    memtable.put(i, i);
-  }
-
-  std::vector<BTreePair*> kv_pairs;
-  memtable.traverse(kv_pairs);
-
-  queue<BTreeNode*> leaf_nodes;
-  BTreeNode* curr_leaf = new BTreeNode();
-
-  for (int64_t i = 0; i < num_entries; i++) {
-    curr_leaf->insert(kv_pairs[i]);
-    if (curr_leaf->get_size() >= 256) {
-      leaf_nodes.push(curr_leaf);
-      curr_leaf = new BTreeNode();
-    }
-  }
-
-  if (curr_leaf->get_size() > 0) {
-    leaf_nodes.push(curr_leaf);
-  }
-
-  BTreeNode* root_node = nullptr;
-
-  if (leaf_nodes.size() == 1) {
-    // There are 256 entries or fewer being flushed
-    // The leaf itself can be the root node
-    root_node = leaf_nodes.front();
-  } else {
-    // There are more than 256 entries being flushed
-    // Thus we have at least two leaf nodes that should be referenced by a
-    // parent
-    bool root_ready = false;
-    queue<BTreeNode*> internal_nodes;
-
-    while (!root_ready) {
-      int num_leaves = leaf_nodes.size();
-      BTreeNode* curr_node = new BTreeNode();
-      int num_internal = std::ceil(static_cast<double>(num_leaves) / 256);
-      int base_distribution = num_leaves / num_internal;
-      int num_extras = num_leaves % num_internal;
-
-      while (num_leaves > 0) {
-        BTreeNode* leaf = leaf_nodes.front();
-        leaf_nodes.pop();
-        curr_node->insert(leaf);
-        num_leaves--;
-        if (num_extras > 0 &&
-            curr_node->get_size() == (base_distribution + 1)) {
-          num_extras--;
-          internal_nodes.push(curr_node);
-          curr_node = new BTreeNode();
-        } else if (num_extras == 0 &&
-                   curr_node->get_size() == base_distribution) {
-          internal_nodes.push(curr_node);
-          curr_node = new BTreeNode();
-        }
-      }
-
-      if (internal_nodes.size() <= 256) {
-        root_ready = true;
-      } else {
-        leaf_nodes = internal_nodes;
-        std::queue<BTreeNode*> empty;
-        std::swap(empty, internal_nodes);
-      }
-    }
-
-    if (internal_nodes.size() == 1) {
-      // There is only one internal node left, make it the root
-      root_node = internal_nodes.front();
-    } else {
-      // There are less than 256 internal nodes, thus we insert them all into
-      // a parent node and return the parent node
-      root_node = new BTreeNode();
-      // Insert all nodes in internal_nodes to root_node
-      while (!internal_nodes.empty()) {
-        root_node->insert(internal_nodes.front());
-        internal_nodes.pop();
-      }
-    }
-  }
-  bool result =
-      (root_node->get_size() == 256) && root_node->isBTreeNode() &&
-      root_node->get_entries()[0]->isBTreeNode() &&
-      root_node->get_entries()[127]->isBTreeNode() &&
-      root_node->get_entries()[255]->isBTreeNode() &&
-      static_cast<BTreeNode*>(root_node->get_entries()[0])->get_max_key() ==
-          256 &&
-      static_cast<BTreeNode*>(root_node->get_entries()[127])->get_max_key() ==
-          32768 &&
-      static_cast<BTreeNode*>(root_node->get_entries()[255])->get_max_key() ==
-          65536;
-  EntryBase::clearBTree(root_node);
-  root_node = nullptr;
+  writeBTree(num_entries);
+
+  // The root holds the largest key and the offset of each leaf
+  int64_t entries_offset = readPage(0)[0];
+  vector<int64_t> root_node = readPage(PAGE_SIZE);
+  bool result = entries_offset == 2 * PAGE_SIZE &&
+                pageSize(root_node) == 256 && root_node[2 * 0] == 256 &&
+                root_node[2 * 127] == 32768 && root_node[2 * 255] == 65536 &&
+                root_node[2 * 0 + 1] == entries_offset &&
+                root_node[2 * 255 + 1] == entries_offset + 255 * PAGE_SIZE &&
+                readPage(root_node[2 * 255 + 1])[2 * 255] == 65536;
+  remove(BTREE_TEST_PATH.c_str());
 
   return result;
 }
 
 bool testThreeInternalNodes(int num_entries) {
-  Memtable memtable(num_entries + 1);
-
-  for (int64_t i = 1; i < num_entries + 1; i++) {
-    memtable.put(i, i);
-  }
-
-  std::vector<BTreePair*> kv_pairs;
-  memtable.traverse(kv_pairs);
-
-  queue<BTreeNode*> leaf_nodes;
-  BTreeNode* curr_leaf = new BTreeNode();
-
-  for (int64_t i = 0; i < num_entries; i++) {
-    curr_leaf->insert(kv_pairs[i]);
-    if (curr_leaf->get_size() >= 256) {
-      leaf_nodes.push(curr_leaf);
-      curr_leaf = new BTreeNode();
-    }
-  }
-
-  if (curr_leaf->get_size() > 0) {
-    leaf_nodes.push(curr_leaf);
-  }
-
-  BTreeNode* root_node = nullptr;
-
-  if (leaf_nodes.size() == 1) {
-    // There are 256 entries or fewer being flushed
-    // The leaf itself can be the root node
-    root_node = leaf_nodes.front();
-  } else {
-    // There are more than 256 entries being flushed
-    // Thus we have at least two leaf nodes that should be referenced by a
-    // parent
-    bool root_ready = false;
-    queue<BTreeNode*> internal_nodes;
-
-    while (!root_ready) {
-      int num_leaves = leaf_nodes.size();
-      BTreeNode* curr_node = new BTreeNode();
-      int num_internal = std::ceil(static_cast<double>(num_leaves) / 256);
-      int base_distribution = num_leaves / num_internal;
-      int num_extras = num_leaves % num_internal;
-
-      while (num_leaves > 0) {
-        BTreeNode* leaf = leaf_nodes.front();
-        leaf_nodes.pop();
-        curr_node->insert(leaf);
-        num_leaves--;
-        if (num_extras > 0 &&
-            curr_node->get_size() == (base_distribution + 1)) {
-          num_extras--;
-          internal_nodes.push(curr_node);
-          curr_node = new BTreeNode();
-        } else if (num_extras == 0 &&
-                   curr_node->get_size() == base_distribution) {
-          internal_nodes.push(curr_node);
-          curr_node = new BTreeNode();
-        }
-      }
-
-      if (internal_nodes.size() <= 256) {
-        root_ready = true;
-      } else {
-        leaf_nodes = internal_nodes;
-        std::queue<BTreeNode*> empty;
-        std::swap(empty, internal_nodes);
-      }
-    }
-
-    if (internal_nodes.size() == 1) {
-      // There is only one internal node left, make it the root
-      root_node = internal_nodes.front();
-    } else {
-      // There are less than 256 internal nodes, thus we insert them all into
-      // a parent node and return the parent node
-      root_node = new BTreeNode();
-      // Insert all nodes in internal_nodes to root_node
-      while (!internal_nodes.empty()) {
-        root_node->insert(internal_nodes.front());
-        internal_nodes.pop();
-      }
-    }
+  writeBTree(num_entries);
+
+  // The root holds three internal nodes of 256 leaves each
+  int64_t entries_offset = readPage(0)[0];
+  vector<int64_t> root_node = readPage(PAGE_SIZE);
+  bool result = entries_offset == 5 * PAGE_SIZE && pageSize(root_node) == 3;
+  for (int i = 0; result && i < 3; i++) {
+    vector<int64_t> internal_node = readPage(root_node[2 * i + 1]);
+    int64_t max_key = 65536 * (i + 1);
+    result = root_node[2 * i] == max_key &&
+             root_node[2 * i + 1] < entries_offset &&
+             pageSize(internal_node) == 256 &&
+             internal_node[2 * 255] == max_key &&
+             internal_node[2 * 255 + 1] >= entries_offset &&
+             readPage(internal_node[2 * 255 + 1])[2 * 255] == max_key;
   }
+  remove(BTREE_TEST_PATH.c_str());
 
-  bool result = (root_node->get_size() == 3) &&
-                (root_node->get_entries()[0]->isBTreeNode()) &&
-                (root_node->get_entries()[1]->isBTreeNode()) &&
-                (root_node->get_entries()[2]->isBTreeNode()) &&
-                (static_cast<BTreeNode*>(
-                     static_cast<BTreeNode*>(root_node->get_entries()[0])
-                         ->get_entries()[255])
-                     ->get_max_key() == 65536) &&
-                (static_cast<BTreeNode*>(
-                     static_cast<BTreeNode*>(root_node->get_entries()[1])
-                         ->get_entries()[255])
-                     ->get_max_key() == 131072) &&
-                (static_cast<BTreeNode*>(
-                     static_cast<BTreeNode*>(root_node->get_entries()[2])
-                         ->get_entries()[255])
-                     ->get_max_key() == 196608) &&
-                !(static_cast<BTreeNode*>(
-                      static_cast<BTreeNode*>(root_node->get_entries()[0])
-                          ->get_entries()[255])
-                      ->get_entries()[0]
-                      ->isBTreeNode()) &&
-                !(static_cast<BTreeNode*>(
-                      static_cast<BTreeNode*>(root_node->get_entries()[1])
-                          ->get_entries()[255])
-                      ->get_entries()[0]
-                      ->isBTreeNode()) &&
-                !(static_cast<BTreeNode*>(
-                      static_cast<BTreeNode*>(root_node->get_entries()[2])
-                          ->get_entries()[255])
-                      ->get_entries()[0]
-                      ->isBTreeNode());
+  return result;
+}
 
-  EntryBase::clearBTree(root_node);
-  root_node = nullptr;
+bool testFewerThanMaxEntries(int num_entries, int max_entries) {
+  writeBTree(num_entries, max_entries);
+
+  // The leaves stay after the pages reserved for max_entries, and the
+  // metadata holds the entries added apart from those the filter is sized for
+  vector<int64_t> metadata = readPage(0);
+  int64_t entries_offset = metadata[0];
+  vector<int64_t> root_node = readPage(PAGE_SIZE);
+  bool result = entries_offset == 4 * PAGE_SIZE && metadata[4] == num_entries &&
+                metadata[12] == max_entries && pageSize(root_node) == 2 &&
+                root_node[2 * 0 + 1] == entries_offset &&
+                root_node[2 * 1] == num_entries &&
+                readPage(root_node[2 * 1 + 1])[2 * 0] == 257;
+  remove(BTREE_TEST_PATH.c_str());
 
   return result;
 }
@@ -360,8 +147,17 @@ bool runBTreeTests() {
   }
   num_tests += 1;
 
+  cout << "Running testFewerThanMaxEntries\n";
+  if (testFewerThanMaxEntries(300, 65537)) {
+    cout << "testFewerThanMaxEntries passed.\n";
+    tests_passed += 1;
+  } else {
+    cout << "testFewerThanMaxEntries failed\n";
+  }
+  num_tests += 1;
+
   cout << "\nTotal of " << tests_passed << "/" << num_tests
        << " passed in btree_test.cc\n";
 
   return tests_passed == num_tests;
-}
\ No newline at end of file
+}
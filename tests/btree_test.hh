@@ -1,3 +1,3 @@
-#include "../src/btree.hh"
+#include "../src/bsst_builder.hh"
 
 bool runBTreeTests();
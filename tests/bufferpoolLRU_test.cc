@@ -6,16 +6,15 @@
 using namespace std;
 
 bool testPutRemoveHead(LRUQueue &queue) {
-  string output = queue.remove_head();
-  if ("" != output) {
-    std::cerr << "Queue should be empty; LRU should return empty string."
+  size_t output = queue.remove_head();
+  if (LRU_NIL != output) {
+    std::cerr << "Queue should be empty; LRU should return LRU_NIL."
               << std::endl;
     return false;
   }
-  string buckets[4] = {"a", "b", "c", "d"};
+  size_t buckets[4] = {0, 1, 2, 3};
   for (auto bucket : buckets) {
-    shared_ptr<LRUNode> node = make_shared<LRUNode>(LRUNode(bucket));
-    queue.put(node);
+    queue.put(bucket);
   }
   for (auto bucket : buckets) {
     output = queue.remove_head();
@@ -26,8 +25,8 @@ bool testPutRemoveHead(LRUQueue &queue) {
     }
   }
   output = queue.remove_head();
-  if ("" != output) {
-    std::cerr << "Queue should be empty; LRU should return empty string."
+  if (LRU_NIL != output) {
+    std::cerr << "Queue should be empty; LRU should return LRU_NIL."
               << std::endl;
     return false;
   }
@@ -35,36 +34,34 @@ bool testPutRemoveHead(LRUQueue &queue) {
 }
 
 bool testMoveToTail(LRUQueue &queue) {
-  string buckets[4] = {"a", "b", "c", "d"};
-  shared_ptr<LRUNode> node[4];
+  size_t buckets[4] = {0, 1, 2, 3};
   for (int i = 0; i < 4; i++) {
-    node[i] = make_shared<LRUNode>(buckets[i]);
-    queue.put(node[i]);
+    queue.put(buckets[i]);
   }
-  queue.move_to_tail(node[0]);
-  string output = queue.remove_head();
-  if ("b" != output) {
-    std::cerr << "bucket is wrong. Expectd: b"
+  queue.move_to_tail(buckets[0]);
+  size_t output = queue.remove_head();
+  if (1 != output) {
+    std::cerr << "bucket is wrong. Expectd: 1"
               << " Actual: " << output << std::endl;
     return false;
   }
-  queue.move_to_tail(node[2]);
+  queue.move_to_tail(buckets[2]);
   output = queue.remove_head();
-  if ("d" != output) {
-    std::cerr << "bucket is wrong. Expectd: d"
+  if (3 != output) {
+    std::cerr << "bucket is wrong. Expectd: 3"
               << " Actual: " << output << std::endl;
     return false;
   }
   output = queue.remove_head();
-  if ("a" != output) {
-    std::cerr << "bucket is wrong. Expectd: a"
+  if (0 != output) {
+    std::cerr << "bucket is wrong. Expectd: 0"
               << " Actual: " << output << std::endl;
     return false;
   }
-  queue.move_to_tail(node[2]);
+  queue.move_to_tail(buckets[2]);
   output = queue.remove_head();
-  if ("c" != output) {
-    std::cerr << "bucket is wrong. Expectd: c"
+  if (2 != output) {
+    std::cerr << "bucket is wrong. Expectd: 2"
               << " Actual: " << output << std::endl;
     return false;
   }
@@ -72,23 +69,21 @@ bool testMoveToTail(LRUQueue &queue) {
 }
 
 bool testRemoveNode() {
-  LRUQueue queue2;
-  string buckets[4] = {"a", "b", "c", "d"};
-  shared_ptr<LRUNode> node[4];
+  LRUQueue queue2(4);
+  size_t buckets[4] = {0, 1, 2, 3};
   for (int i = 0; i < 4; i++) {
-    node[i] = make_shared<LRUNode>(buckets[i]);
-    queue2.put(node[i]);
+    queue2.put(buckets[i]);
   }
-  queue2.remove_node(node[1]);
-  string output = queue2.remove_head();
-  if ("a" != output) {
-    std::cerr << "bucket is wrong. Expectd: a"
+  queue2.remove_node(buckets[1]);
+  size_t output = queue2.remove_head();
+  if (0 != output) {
+    std::cerr << "bucket is wrong. Expectd: 0"
               << " Actual: " << output << std::endl;
     return false;
   }
   output = queue2.remove_head();
-  if ("c" != output) {
-    std::cerr << "bucket is wrong. Expectd: c"
+  if (2 != output) {
+    std::cerr << "bucket is wrong. Expectd: 2"
               << " Actual: " << output << std::endl;
     return false;
   }
@@ -96,7 +91,7 @@ bool testRemoveNode() {
 }
 
 bool runBufferpoolLRUTests() {
-  LRUQueue queue;
+  LRUQueue queue(4);
 
   int test_pass_counter = 0;
   int total_tests = 0;
@@ -1,7 +1,10 @@
 #include "../src/bufferpool.hh"
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <thread>
 
 #include "bufferpool_test.hh"
 #include "constants.hh"
@@ -9,7 +12,7 @@ using namespace std;
 
 bool testInsertAndSearch(Bufferpool &bufferpool,
                          vector<vector<KeyValuePair>> page_array,
-                         const string (&pageIds)[5]) {
+                         const PageId (&pageIds)[5]) {
   for (int i = 0; i < 3; i++) {
     /* want to use # as divder here */
     vector<KeyValuePair> input(PAGE_NUM_ENTRIES);
@@ -18,12 +21,12 @@ bool testInsertAndSearch(Bufferpool &bufferpool,
   }
   /* Included test for collision resolution by linked buckets */
   for (int i = 0; i < 3; i++) {
-    vector<KeyValuePair> *result = bufferpool.search(pageIds[i]);
+    const KeyValuePair *result = bufferpool.search(pageIds[i]);
     if (!result) {
       std::cerr << "Expect page but the page does not exist." << std::endl;
       return false;
     }
-    vector<KeyValuePair> output = *result;
+    const KeyValuePair *output = result;
     for (int j = 0; j < PAGE_NUM_ENTRIES; j++) {
       if (output[j].key != i * PAGE_NUM_ENTRIES + j ||
           output[j].value != i * PAGE_NUM_ENTRIES + j) {
@@ -40,14 +43,14 @@ bool testInsertAndSearch(Bufferpool &bufferpool,
 }
 
 bool testEvict(Bufferpool &bufferpool, vector<vector<KeyValuePair>> page_array,
-               const string (&pageIds)[5]) {
+               const PageId (&pageIds)[5]) {
   for (int i = 3; i < 5; i++) {
     vector<KeyValuePair> input(PAGE_NUM_ENTRIES);
     input = page_array[i];
     bufferpool.insert(pageIds[i], input);
   }
   for (int i = 0; i < 5; i++) {
-    vector<KeyValuePair> *result = bufferpool.search(pageIds[i]);
+    const KeyValuePair *result = bufferpool.search(pageIds[i]);
     // bool result = bufferpool.search(pageIds[i]);
     if (i < 2 && result) {
       std::cerr << "Expect no page but the page exists: " << pageIds[i]
@@ -58,7 +61,7 @@ bool testEvict(Bufferpool &bufferpool, vector<vector<KeyValuePair>> page_array,
         std::cerr << "Expect page but the page does not exist." << std::endl;
         return false;
       }
-      vector<KeyValuePair> output = *result;
+      const KeyValuePair *output = result;
       for (int j = 0; j < PAGE_NUM_ENTRIES; j++) {
         if (page_array[i][j].key != output[j].key ||
             page_array[i][j].value != output[j].value) {
@@ -76,7 +79,7 @@ bool testEvict(Bufferpool &bufferpool, vector<vector<KeyValuePair>> page_array,
 
 bool testEvictWithMultiRead(Bufferpool &bufferpool,
                             vector<vector<KeyValuePair>> page_array,
-                            const string (&pageIds)[5]) {
+                            const PageId (&pageIds)[5]) {
   // KeyValuePair *output;
   bufferpool.search(pageIds[2]);
   bufferpool.search(pageIds[3]);
@@ -90,7 +93,7 @@ bool testEvictWithMultiRead(Bufferpool &bufferpool,
   bufferpool.insert(pageIds[1], input2);
   for (int i = 0; i < 5; i++) {
     // KeyValuePair *output;
-    vector<KeyValuePair> *result = bufferpool.search(pageIds[i]);
+    const KeyValuePair *result = bufferpool.search(pageIds[i]);
     // bool result = bufferpool.search(pageIds[i]);
     if (i == 0 || i == 4) {
       if (result) {
@@ -103,7 +106,7 @@ bool testEvictWithMultiRead(Bufferpool &bufferpool,
         std::cerr << "Expect page but the page does not exist." << std::endl;
         return false;
       }
-      vector<KeyValuePair> output = *result;
+      const KeyValuePair *output = result;
       for (int j = 0; j < PAGE_NUM_ENTRIES; j++) {
         if (page_array[i][j].key != output[j].key ||
             page_array[i][j].value != output[j].value) {
@@ -120,7 +123,7 @@ bool testEvictWithMultiRead(Bufferpool &bufferpool,
 }
 
 bool testExpand(vector<vector<KeyValuePair>> page_array,
-                const string (&pageIds)[5]) {
+                const PageId (&pageIds)[5]) {
   Bufferpool bufferpool(3);
   bufferpool.resize(5);
   for (int i = 0; i < 5; i++) {
@@ -131,12 +134,12 @@ bool testExpand(vector<vector<KeyValuePair>> page_array,
 
   /* Included test for collision resolution by linked buckets */
   for (int i = 0; i < 5; i++) {
-    vector<KeyValuePair> *result = bufferpool.search(pageIds[i]);
+    const KeyValuePair *result = bufferpool.search(pageIds[i]);
     if (!result) {
       std::cerr << "Expect page but the page does not exist." << std::endl;
       return false;
     }
-    vector<KeyValuePair> output = *result;
+    const KeyValuePair *output = result;
     for (int j = 0; j < PAGE_NUM_ENTRIES; j++) {
       if (page_array[i][j].key != output[j].key ||
           page_array[i][j].value != output[j].value) {
@@ -152,7 +155,7 @@ bool testExpand(vector<vector<KeyValuePair>> page_array,
 }
 
 bool testShrink(vector<vector<KeyValuePair>> page_array,
-                const string (&pageIds)[5]) {
+                const PageId (&pageIds)[5]) {
   Bufferpool bufferpool(5);
   bufferpool.resize(3);
   for (int i = 0; i < 5; i++) {
@@ -161,7 +164,7 @@ bool testShrink(vector<vector<KeyValuePair>> page_array,
     bufferpool.insert(pageIds[i], input);
   }
   for (int i = 0; i < 5; i++) {
-    vector<KeyValuePair> *result = bufferpool.search(pageIds[i]);
+    const KeyValuePair *result = bufferpool.search(pageIds[i]);
     if (i < 2) {
       if (result) {
         std::cerr << "Expect no page but the page exists: " << pageIds[i]
@@ -173,7 +176,7 @@ bool testShrink(vector<vector<KeyValuePair>> page_array,
         std::cerr << "Expect page but the page does not exist." << std::endl;
         return false;
       }
-      vector<KeyValuePair> output = *result;
+      const KeyValuePair *output = result;
       for (int j = 0; j < PAGE_NUM_ENTRIES; j++) {
         if (page_array[i][j].key != output[j].key ||
             page_array[i][j].value != output[j].value) {
@@ -190,7 +193,7 @@ bool testShrink(vector<vector<KeyValuePair>> page_array,
 }
 
 bool testShrink2(vector<vector<KeyValuePair>> page_array,
-                 const string (&pageIds)[5]) {
+                 const PageId (&pageIds)[5]) {
   Bufferpool bufferpool(5);
   for (int i = 0; i < 5; i++) {
     vector<KeyValuePair> input(PAGE_NUM_ENTRIES);
@@ -199,7 +202,7 @@ bool testShrink2(vector<vector<KeyValuePair>> page_array,
   }
   bufferpool.resize(3);
   for (int i = 0; i < 5; i++) {
-    vector<KeyValuePair> *result = bufferpool.search(pageIds[i]);
+    const KeyValuePair *result = bufferpool.search(pageIds[i]);
     if (i < 2) {
       if (result) {
         std::cerr << "Expect no page but the page exists: " << pageIds[i]
@@ -211,7 +214,7 @@ bool testShrink2(vector<vector<KeyValuePair>> page_array,
         std::cerr << "Expect page but the page does not exist." << std::endl;
         return false;
       }
-      vector<KeyValuePair> output = *result;
+      const KeyValuePair *output = result;
       for (int j = 0; j < PAGE_NUM_ENTRIES; j++) {
         if (page_array[i][j].key != output[j].key ||
             page_array[i][j].value != output[j].value) {
@@ -227,13 +230,216 @@ bool testShrink2(vector<vector<KeyValuePair>> page_array,
   return true;
 }
 
+bool testPinnedPageNotEvicted(vector<vector<KeyValuePair>> page_array,
+                              const PageId (&pageIds)[5]) {
+  Bufferpool bufferpool(2);
+  vector<KeyValuePair> input = page_array[0];
+  PageHandle pinned = bufferpool.insert(pageIds[0], std::move(input));
+  if (!pinned || pinned[1].key != page_array[0][1].key) {
+    std::cerr << "Expect a handle on the inserted page." << std::endl;
+    return false;
+  }
+  // Page 0 is the least recently used but pinned, so page 1 is evicted
+  for (int i = 1; i < 3; i++) {
+    vector<KeyValuePair> page = page_array[i];
+    bufferpool.insert(pageIds[i], std::move(page));
+  }
+  if (!bufferpool.search(pageIds[0]) || bufferpool.search(pageIds[1]) ||
+      bufferpool.remove(pageIds[0])) {
+    std::cerr << "Expect pinned page to stay in buffer pool." << std::endl;
+    return false;
+  }
+  if (pinned[PAGE_NUM_ENTRIES - 1].key !=
+      page_array[0][PAGE_NUM_ENTRIES - 1].key) {
+    std::cerr << "Pinned page changed." << std::endl;
+    return false;
+  }
+  // Once unpinned the page can be removed again
+  pinned.release();
+  PageHandle handle = bufferpool.pin(pageIds[2]);
+  return handle && handle[0].key == page_array[2][0].key &&
+         bufferpool.remove(pageIds[0]);
+}
+
+bool testRemoveKeepsOtherPages() {
+  // Removing pages must not hide pages further along their probe sequence
+  Bufferpool bufferpool(64);
+  vector<KeyValuePair> page(PAGE_NUM_ENTRIES);
+  for (int i = 0; i < 64; i++) {
+    page[0].key = i;
+    bufferpool.insert(make_page_id(i % 3, i), page);
+  }
+  for (int i = 0; i < 64; i += 2) {
+    if (!bufferpool.remove(make_page_id(i % 3, i))) {
+      std::cerr << "Expect page to be removed: " << i << std::endl;
+      return false;
+    }
+  }
+  for (int i = 0; i < 64; i++) {
+    const KeyValuePair *result = bufferpool.search(make_page_id(i % 3, i));
+    if ((i % 2 == 0) != (result == nullptr) ||
+        (result && result[0].key != i)) {
+      std::cerr << "Wrong page after removal: " << i << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool testEvictionPolicies(vector<vector<KeyValuePair>> page_array,
+                          const PageId (&pageIds)[5]) {
+  // Every policy keeps a page that was hit over one that was only inserted
+  for (const string policy : {LRU_POLICY, CLOCK_POLICY, ARC_POLICY}) {
+    Bufferpool bufferpool(3, policy);
+    for (int i = 0; i < 3; i++) {
+      bufferpool.insert(pageIds[i], page_array[i]);
+    }
+    bufferpool.search(pageIds[0]);
+    bufferpool.insert(pageIds[3], page_array[3]);
+    for (int i = 0; i < 4; i++) {
+      const KeyValuePair *result = bufferpool.search(pageIds[i]);
+      if ((i == 1) != (result == nullptr) ||
+          (result && result[0].key != page_array[i][0].key)) {
+        std::cerr << "Policy " << policy << " evicted the wrong page: " << i
+                  << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool testScanAccessEvictedFirst(vector<vector<KeyValuePair>> page_array,
+                                const PageId (&pageIds)[5]) {
+  // Pages read by scans, or only hit by scans, go before hot pages
+  for (const string policy : {LRU_POLICY, CLOCK_POLICY, ARC_POLICY}) {
+    Bufferpool bufferpool(3, policy);
+    for (int i = 0; i < 2; i++) {
+      bufferpool.insert(pageIds[i], page_array[i]);
+    }
+    KeyValuePair *page_data;
+    PageHandle scanned =
+        bufferpool.allocate_page(pageIds[2], page_data, SCAN_ACCESS);
+    memcpy(page_data, page_array[2].data(), PAGE_SIZE);
+    scanned.finish_load();
+    scanned.release();
+    bufferpool.pin(pageIds[2], SCAN_ACCESS).release();
+    bufferpool.insert(pageIds[3], page_array[3]);
+    for (int i = 0; i < 4; i++) {
+      const KeyValuePair *result = bufferpool.search(pageIds[i]);
+      if ((i == 2) != (result == nullptr)) {
+        std::cerr << "Policy " << policy << " evicted the wrong page: " << i
+                  << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool testShardedConcurrentReads() {
+  // Threads read overlapping pages through a sharded bufferpool too small to
+  // hold them all, every page they see must be the one they asked for
+  Bufferpool bufferpool(32, LRU_POLICY, 4);
+  const int num_threads = 4;
+  bool ok[num_threads];
+  vector<thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    ok[t] = true;
+    threads.emplace_back([&bufferpool, &ok, t]() {
+      for (int i = 0; i < 20000; i++) {
+        uint32_t page_number = (i * 7 + t) % 128;
+        PageId page_id = make_page_id(1, page_number);
+        PageHandle page = bufferpool.pin(page_id);
+        if (!page) {
+          KeyValuePair *page_data;
+          page = bufferpool.allocate_page(page_id, page_data);
+          if (page_data) {
+            for (int j = 0; j < PAGE_NUM_ENTRIES; j++) {
+              page_data[j] = KeyValuePair{page_number, j};
+            }
+            page.finish_load();
+          }
+        }
+        if (page && (page[0].key != page_number ||
+                     page[PAGE_NUM_ENTRIES - 1].key != page_number)) {
+          ok[t] = false;
+        }
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  for (int t = 0; t < num_threads; t++) {
+    if (!ok[t]) {
+      std::cerr << "Thread " << t << " read the wrong page." << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool testSetNumShards() {
+  // Resharding drops cached pages but keeps the whole capacity
+  Bufferpool bufferpool(32);
+  vector<KeyValuePair> page(PAGE_NUM_ENTRIES);
+  bufferpool.insert(make_page_id(1, 0), page);
+  bufferpool.set_num_shards(4);
+  if (bufferpool.search(make_page_id(1, 0)) != nullptr) {
+    std::cerr << "Expect cached pages to be dropped." << std::endl;
+    return false;
+  }
+  for (int i = 0; i < 32; i++) {
+    page[0].key = i;
+    bufferpool.insert(make_page_id(1, i), page);
+  }
+  // Pages spread unevenly over the shards, so some of them were evicted,
+  // but every page still cached must be the one inserted
+  int num_cached = 0;
+  for (int i = 0; i < 32; i++) {
+    const KeyValuePair *result = bufferpool.search(make_page_id(1, i));
+    if (result && result[0].key != i) {
+      std::cerr << "Wrong page after resharding: " << i << std::endl;
+      return false;
+    }
+    num_cached += result != nullptr;
+  }
+  if (num_cached == 0) {
+    std::cerr << "Expect pages to be cached after resharding." << std::endl;
+    return false;
+  }
+
+  // A pinned page in any shard keeps every shard as it was
+  // The last page inserted into its shard is still cached
+  PageHandle pinned = bufferpool.pin(make_page_id(1, 31));
+  if (!pinned) {
+    std::cerr << "Expect the last page inserted to be cached." << std::endl;
+    return false;
+  }
+  try {
+    bufferpool.set_num_shards(2);
+    std::cerr << "Expect resharding with a pinned page to throw." << std::endl;
+    return false;
+  } catch (const runtime_error &) {
+  }
+  for (int i = 0; i < 32; i++) {
+    num_cached -= bufferpool.search(make_page_id(1, i)) != nullptr;
+  }
+  if (num_cached != 0) {
+    std::cerr << "Expect cached pages to stay after a failed resharding."
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
 bool runBufferpoolTests() {
   Bufferpool bufferpool(3);
-  string pageIds[5];
+  PageId pageIds[5];
   vector<vector<KeyValuePair>> page_array(5);
   for (int i = 0; i < 5; i++) {
-    size_t offset = i * PAGE_SIZE;
-    pageIds[i] = "SST_0#" + to_string(offset);
+    pageIds[i] = make_page_id(0, i);
     page_array[i].resize(PAGE_NUM_ENTRIES);
     for (int j = 0; j < PAGE_NUM_ENTRIES; j++) {
       page_array[i][j].key = i * PAGE_NUM_ENTRIES + j;
@@ -297,6 +503,60 @@ bool runBufferpoolTests() {
   }
   total_tests += 1;
 
+  cout << "Running testPinnedPageNotEvicted\n";
+  if (testPinnedPageNotEvicted(page_array, pageIds)) {
+    cout << "testPinnedPageNotEvicted passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testPinnedPageNotEvicted failed.\n";
+  }
+  total_tests += 1;
+
+  cout << "Running testRemoveKeepsOtherPages\n";
+  if (testRemoveKeepsOtherPages()) {
+    cout << "testRemoveKeepsOtherPages passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testRemoveKeepsOtherPages failed.\n";
+  }
+  total_tests += 1;
+
+  cout << "Running testEvictionPolicies\n";
+  if (testEvictionPolicies(page_array, pageIds)) {
+    cout << "testEvictionPolicies passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testEvictionPolicies failed.\n";
+  }
+  total_tests += 1;
+
+  cout << "Running testScanAccessEvictedFirst\n";
+  if (testScanAccessEvictedFirst(page_array, pageIds)) {
+    cout << "testScanAccessEvictedFirst passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testScanAccessEvictedFirst failed.\n";
+  }
+  total_tests += 1;
+
+  cout << "Running testShardedConcurrentReads\n";
+  if (testShardedConcurrentReads()) {
+    cout << "testShardedConcurrentReads passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testShardedConcurrentReads failed.\n";
+  }
+  total_tests += 1;
+
+  cout << "Running testSetNumShards\n";
+  if (testSetNumShards()) {
+    cout << "testSetNumShards passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testSetNumShards failed.\n";
+  }
+  total_tests += 1;
+
   cout << "\nTotal of " << test_pass_counter << "/" << total_tests
        << " passed in bufferpool.cc\n";
   return test_pass_counter == total_tests;
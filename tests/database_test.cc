@@ -326,6 +326,99 @@ bool testScanOutOfRange2(Database& database) {
   return true;
 }
 
+bool testScanLimit(Database& database) {
+  // Two pages of three results, the first starting in the memtable
+  ScanResponse firstPage = database.Scan(8, 1280, 3);
+  vector<KeyValuePair> correctVector = {{8, 10}, {9, 10}, {10, 10}};
+  if (firstPage.size != 3) {
+    return false;
+  }
+  for (size_t i = 0; i < correctVector.size(); ++i) {
+    if (firstPage.result[i].key != correctVector[i].key ||
+        firstPage.result[i].value != correctVector[i].value) {
+      return false;
+    }
+  }
+
+  ScanResponse secondPage =
+      database.Scan(firstPage.result.back().key + 1, 1280, 3);
+  correctVector = {{11, 11}, {12, 12}, {13, 13}};
+  if (secondPage.size != 3) {
+    return false;
+  }
+  for (size_t i = 0; i < correctVector.size(); ++i) {
+    if (secondPage.result[i].key != correctVector[i].key ||
+        secondPage.result[i].value != correctVector[i].value) {
+      return false;
+    }
+  }
+  return database.Scan(8, 1280, 0).size == 0;
+}
+
+bool testIterator(Database& database) {
+  unique_ptr<Iterator> it = database.NewIterator();
+  it->Seek(1278);
+  vector<KeyValuePair> correctVector = {
+      {1278, 1278}, {1279, 1279}, {1280, 1280}};
+  for (size_t i = 0; i < correctVector.size(); ++i) {
+    if (!it->Valid() || it->key() != correctVector[i].key ||
+        it->value() != correctVector[i].value) {
+      return false;
+    }
+    it->Next();
+  }
+  if (it->Valid()) {
+    return false;
+  }
+
+  it->Seek(9);
+  if (!it->Valid() || it->key() != 9 || it->value() != 10) {
+    return false;
+  }
+
+  // Turn around in both directions
+  it->Prev();
+  if (!it->Valid() || it->key() != 8 || it->value() != 10) {
+    return false;
+  }
+  it->Next();
+  return it->Valid() && it->key() == 9 && it->value() == 10;
+}
+
+bool testReverseScan(Database& database) {
+  // Newest versions from the memtable, across the memtable and the SSTs
+  ScanResponse scanResponse = database.ReverseScan(5, 11, 5);
+  vector<KeyValuePair> correctVector = {
+      {11, 11}, {10, 10}, {9, 10}, {8, 10}, {7, 7}};
+  if (scanResponse.size != 5) {
+    return false;
+  }
+  for (size_t i = 0; i < correctVector.size(); ++i) {
+    if (scanResponse.result[i].key != correctVector[i].key ||
+        scanResponse.result[i].value != correctVector[i].value) {
+      return false;
+    }
+  }
+
+  // Over a page boundary, and past the end of the SSTs
+  scanResponse = database.ReverseScan(250, 260);
+  if (scanResponse.size != 11 || scanResponse.result[0].key != 260 ||
+      scanResponse.result[10].key != 250) {
+    return false;
+  }
+  scanResponse = database.ReverseScan(1278, 99999, 2);
+  return scanResponse.size == 2 && scanResponse.result[0].key == 1280 &&
+         scanResponse.result[1].key == 1279;
+}
+
+bool testAggregateSortedSST(Database& database) {
+  // Sorted SSTs have no leaf summaries, every entry is merged
+  return database.Aggregate(5, 11, AGGREGATE_COUNT) == 7 &&
+         database.Aggregate(5, 11, AGGREGATE_SUM) == 5 + 6 + 7 + 30 + 11 &&
+         database.Aggregate(5, 11, AGGREGATE_MAX) == 11 &&
+         database.Aggregate(1275, 1300, AGGREGATE_MIN) == 1275;
+}
+
 bool runDatabaseTests() {
   deleteAllFilesInDirectory("tests/ssts/database_test");
 
@@ -486,6 +579,42 @@ bool runDatabaseTests() {
   }
   total_tests += 1;
 
+  cout << "Running testScanLimit\n";
+  if (testScanLimit(database)) {
+    cout << "testScanLimit passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testScanLimit failed.\n";
+  }
+  total_tests += 1;
+
+  cout << "Running testIterator\n";
+  if (testIterator(database)) {
+    cout << "testIterator passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testIterator failed.\n";
+  }
+  total_tests += 1;
+
+  cout << "Running testReverseScan\n";
+  if (testReverseScan(database)) {
+    cout << "testReverseScan passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testReverseScan failed.\n";
+  }
+  total_tests += 1;
+
+  cout << "Running testAggregateSortedSST\n";
+  if (testAggregateSortedSST(database)) {
+    cout << "testAggregateSortedSST passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testAggregateSortedSST failed.\n";
+  }
+  total_tests += 1;
+
   cout << "\nTotal of " << test_pass_counter << "/" << total_tests
        << " passed in database.cc\n";
   return test_pass_counter == total_tests;
@@ -249,6 +249,33 @@ bool testScanAfterCompactionLvl3(Database& database) {
   return true;
 }
 
+bool testKeyRangeRecorded(Database& database, const string& directoryPath) {
+  DIR* dir = opendir(directoryPath.c_str());
+  if (dir == nullptr) {
+    std::cerr << "Error: Unable to open directory." << std::endl;
+    return false;
+  }
+
+  string sst;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    if (entry->d_type == DT_REG &&
+        string(entry->d_name).find(".bin") != string::npos) {
+      sst = entry->d_name;
+    }
+  }
+  closedir(dir);
+
+  // The compacted SST holds keys 1 to 20
+  shared_ptr<TableReader> reader = database.get_table_reader(sst);
+  if (reader->min_key != 1 || reader->max_key != 20) {
+    cout << "Expected key range [1, 20], got [" << reader->min_key << ", "
+         << reader->max_key << "]\n";
+    return false;
+  }
+  return reader->overlaps(20, 25) && !reader->overlaps(21, 25);
+}
+
 bool testSSTAfterClose(Database& database) {
   int64_t value1 = database.Get(4);
   if (value1 != 4) {
@@ -296,6 +323,163 @@ bool testSSTAfterUpdateDelete(Database& database) {
   return true;
 }
 
+bool testGetWithoutResidentFilters(Database& database) {
+  // With no budget the filters are no longer held in memory and have to be
+  // read from the SSTs on every Get
+  database.set_filter_cache_budget(0);
+
+  int64_t value1 = database.Get(17);
+  int64_t value2 = database.Get(8);
+  int64_t value3 = database.Get(1000);
+
+  database.set_filter_cache_budget(FILTER_CACHE_BUDGET);
+
+  if (value1 != 99) {
+    cout << "Expected value: " << value1 << "\n";
+    return false;
+  }
+  if (value2 != -1 || value3 != -1) {
+    cout << "Expected value: -1\n";
+    return false;
+  }
+  return true;
+}
+
+bool testBlockedFilterSSTs(const string& dir_path) {
+  // SSTs written with blocked filters are read alongside the standard ones
+  Database database(5, 5);
+  database.Open(dir_path, LSM_TREE);
+  database.set_filter_type(BLOCKED_BLOOM_FILTER);
+  for (int64_t key = 101; key <= 120; key++) {
+    database.Put(key, key * 2);
+  }
+
+  bool passed = true;
+  for (int64_t key = 101; passed && key <= 120; key++) {
+    passed = database.Get(key) == key * 2;
+  }
+  if (passed && (database.Get(121) != -1 || database.Get(1000) != -1)) {
+    cout << "Expected value: -1\n";
+    passed = false;
+  }
+
+  database.Close();
+  return passed;
+}
+
+bool testMmapReadMode(const string& dir_path, ScanResponse& expected) {
+  // Reopen the same SSTs memory-mapped, every read must match O_DIRECT reads
+  Database database(5, 5, 10, MMAP_IO);
+  database.Open(dir_path, LSM_TREE);
+
+  ScanResponse scan = database.Scan(1, 100);
+  bool passed = scan.size == expected.size;
+  for (int i = 0; passed && i < scan.size; i++) {
+    passed = scan.result[i].key == expected.result[i].key &&
+             scan.result[i].value == expected.result[i].value;
+  }
+  for (int i = 0; passed && i < expected.size; i++) {
+    passed = database.Get(expected.result[i].key) == expected.result[i].value;
+  }
+  if (passed && (database.Get(8) != -1 || database.Get(1000) != -1)) {
+    cout << "Expected value: -1\n";
+    passed = false;
+  }
+
+  database.Close();
+  return passed;
+}
+
+bool testBackgroundFlush(const string& dir_path) {
+  // Full memtables are written by the flush thread, every key stays readable
+  // while they wait for it and after they become SSTs
+  Database database(5, 5);
+  database.Open(dir_path, LSM_TREE);
+  database.set_background_flush(true, 2);
+  bool passed = true;
+  for (int64_t key = 201; key <= 300; key++) {
+    database.Put(key, key * 3);
+    passed = passed && database.Get(key) == key * 3 &&
+             database.Get(201) == 603 && database.Get(key - 4) != 0;
+  }
+  // Overwrite and delete keys that may still be in immutable memtables
+  database.Put(298, 1);
+  database.Put(297, 0);
+  ScanResponse scan = database.Scan(201, 300);
+  passed = passed && scan.size == 99 && scan.result[96].value == 1 &&
+           database.Aggregate(201, 300, AGGREGATE_COUNT) == 99 &&
+           database.MultiGet({297, 298, 299})[1] == 1;
+  database.Close();
+
+  // Nothing is left in temporary files once closed
+  DIR* dir = opendir(dir_path.c_str());
+  struct dirent* entry;
+  while (dir != nullptr && (entry = readdir(dir)) != nullptr) {
+    if (string(entry->d_name).find(".tmp") != string::npos) {
+      passed = false;
+    }
+  }
+  if (dir != nullptr) {
+    closedir(dir);
+  }
+
+  Database reopened(5, 5);
+  reopened.Open(dir_path, LSM_TREE);
+  for (int64_t key = 201; passed && key <= 296; key++) {
+    passed = reopened.Get(key) == key * 3;
+  }
+  passed = passed && reopened.Get(297) == -1 && reopened.Get(298) == 1;
+  reopened.Close();
+  return passed;
+}
+
+bool testCompactionOfManyLeaves(const string& dir_path) {
+  // SSTs of several leaves are merged into one that keeps the newer value of
+  // every key and its tombstones
+  Database database(1000, 5);
+  database.Open(dir_path, LSM_TREE);
+  for (int64_t key = 1001; key <= 2000; key++) {
+    database.Put(key, key);
+  }
+  for (int64_t key = 1501; key <= 2500; key++) {
+    database.Put(key, key % 10 == 0 ? 0 : key * 2);
+  }
+
+  bool passed = true;
+  for (int64_t key = 1001; passed && key <= 2500; key++) {
+    int64_t expected = key <= 1500 ? key : key % 10 == 0 ? -1 : key * 2;
+    passed = database.Get(key) == expected;
+  }
+  passed = passed && database.Scan(1001, 2500).size == 1400 &&
+           database.Aggregate(1001, 2500, AGGREGATE_COUNT) == 1400;
+  database.Close();
+  return passed;
+}
+
+bool testCompactionOfOverlappingSSTs(const string& dir_path) {
+  // Two SSTs of the same keys merge into a single leaf, which must become
+  // the root of the compacted SST
+  deleteAllFilesInDirectory(dir_path);
+  Database database(200, 64);
+  database.Open(dir_path, LSM_TREE);
+  for (int64_t key = 1; key <= 200; key++) {
+    database.Put(key, key);
+  }
+  for (int64_t key = 1; key <= 200; key++) {
+    database.Put(key, key * 10 + 1);
+  }
+
+  ScanResponse scan = database.Scan(1, 300);
+  bool passed = scan.size == 200 && database.Get(5) == 51 &&
+                database.Get(201) == -1 &&
+                database.MultiGet({5, 200})[1] == 2001;
+  for (int i = 0; passed && i < scan.size; i++) {
+    passed = scan.result[i].value == scan.result[i].key * 10 + 1;
+  }
+  database.Close();
+  return passed;
+}
+
 bool runLSMTests() {
   string dir_path = "tests/ssts/lsm_test";
   deleteAllFilesInDirectory(dir_path);
@@ -378,6 +562,15 @@ bool runLSMTests() {
   }
   total_tests += 1;
 
+  cout << "Running testKeyRangeRecorded\n";
+  if (testKeyRangeRecorded(database, dir_path)) {
+    cout << "testKeyRangeRecorded passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testKeyRangeRecorded failed.\n";
+  }
+  total_tests += 1;
+
   // Now testing the close and open database to see if the memtable is still
   // structured
   database.Close();
@@ -415,8 +608,63 @@ bool runLSMTests() {
   }
   total_tests += 1;
 
+  cout << "Running testGetWithoutResidentFilters\n";
+  if (testGetWithoutResidentFilters(database)) {
+    cout << "testGetWithoutResidentFilters passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testGetWithoutResidentFilters failed.\n";
+  }
+  total_tests += 1;
+
+  ScanResponse direct_scan = database.Scan(1, 100);
   database.Close();
 
+  cout << "Running testMmapReadMode\n";
+  if (testMmapReadMode(dir_path, direct_scan)) {
+    cout << "testMmapReadMode passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testMmapReadMode failed.\n";
+  }
+  total_tests += 1;
+
+  cout << "Running testBlockedFilterSSTs\n";
+  if (testBlockedFilterSSTs(dir_path)) {
+    cout << "testBlockedFilterSSTs passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testBlockedFilterSSTs failed.\n";
+  }
+  total_tests += 1;
+
+  cout << "Running testBackgroundFlush\n";
+  if (testBackgroundFlush(dir_path)) {
+    cout << "testBackgroundFlush passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testBackgroundFlush failed.\n";
+  }
+  total_tests += 1;
+
+  cout << "Running testCompactionOfManyLeaves\n";
+  if (testCompactionOfManyLeaves(dir_path)) {
+    cout << "testCompactionOfManyLeaves passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testCompactionOfManyLeaves failed.\n";
+  }
+  total_tests += 1;
+
+  cout << "Running testCompactionOfOverlappingSSTs\n";
+  if (testCompactionOfOverlappingSSTs(dir_path + "/overlap")) {
+    cout << "testCompactionOfOverlappingSSTs passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testCompactionOfOverlappingSSTs failed.\n";
+  }
+  total_tests += 1;
+
   cout << "\nTotal of " << test_pass_counter << "/" << total_tests
        << " passed in lsm_test.cc\n";
   return test_pass_counter == total_tests;
@@ -11,9 +11,12 @@
 #include <fstream>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <thread>
 
+#include "../src/merging_iterator.hh"
 #include "memtable_test.hh"
 using namespace std;
 
@@ -168,6 +171,140 @@ bool testScan3(Memtable& memtable) {
   return true;
 }
 
+bool testMergingIterator() {
+  // The newer memtable shadows key 2 and deletes key 5 of the older one
+  Memtable newer(20);
+  Memtable older(20);
+  newer.put(9, 9);
+  newer.put(2, 20);
+  newer.put(5, 0);
+  older.put(7, 7);
+  older.put(5, 5);
+  older.put(1, 1);
+  older.put(2, 2);
+
+  vector<unique_ptr<Iterator>> sources;
+  sources.emplace_back(new MemtableIterator(newer));
+  sources.emplace_back(new MemtableIterator(older));
+  MergingIterator it(std::move(sources));
+
+  vector<KeyValuePair> correctVector = {{1, 1}, {2, 20}, {7, 7}, {9, 9}};
+  vector<KeyValuePair> values;
+  for (it.SeekToFirst(); it.Valid(); it.Next()) {
+    values.push_back({it.key(), it.value()});
+  }
+  if (values.size() != correctVector.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (values[i].key != correctVector[i].key ||
+        values[i].value != correctVector[i].value) {
+      return false;
+    }
+  }
+
+  it.Seek(3);
+  return it.Valid() && it.key() == 7 && it.value() == 7;
+}
+
+bool testSkipListMemtable() {
+  Memtable memtable(100, 10, SKIPLIST_MEMTABLE);
+  for (int64_t key : {8, 3, 12, 5, 1}) {
+    memtable.put(key, key);
+  }
+  memtable.put(5, 50);
+  if (memtable.get_size() != 5 || memtable.get(5) != 50 ||
+      memtable.get(4) != -1) {
+    return false;
+  }
+
+  vector<KeyValuePair> values = memtable.scan(3, 8);
+  vector<KeyValuePair> correctVector = {{3, 3}, {5, 50}, {8, 8}};
+  if (values.size() != correctVector.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (values[i].key != correctVector[i].key ||
+        values[i].value != correctVector[i].value) {
+      return false;
+    }
+  }
+
+  // Walk backwards from 10, then forwards again
+  MemtableIterator it(memtable);
+  it.SeekForPrev(10);
+  vector<int64_t> keys;
+  for (; it.Valid(); it.Prev()) {
+    keys.push_back(it.key());
+  }
+  it.Seek(9);
+  return keys == vector<int64_t>{8, 5, 3, 1} && it.Valid() && it.key() == 12;
+}
+
+bool testSkipListConcurrentPuts() {
+  // Threads insert interleaved keys, plus one key they all update
+  const int num_threads = 4;
+  const int keys_per_thread = 20000;
+  Memtable memtable(num_threads * keys_per_thread + 2, 10, SKIPLIST_MEMTABLE);
+  vector<thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&memtable, t, keys_per_thread, num_threads]() {
+      for (int i = 0; i < keys_per_thread; i++) {
+        memtable.put((int64_t)i * num_threads + t + 1, t + 1);
+        memtable.put(-1, t + 1);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  if (memtable.get_size() != num_threads * keys_per_thread + 1 ||
+      memtable.get(-1) < 1 || memtable.get(-1) > num_threads) {
+    return false;
+  }
+  MemtableIterator it(memtable);
+  int64_t expected = 1;
+  for (it.Seek(1); it.Valid(); it.Next()) {
+    if (it.key() != expected || it.value() != (expected - 1) % num_threads + 1) {
+      return false;
+    }
+    expected++;
+  }
+  return expected == num_threads * keys_per_thread + 1;
+}
+
+bool testPutSorted() {
+  // A sorted batch lands in both memtable types as if put one by one, the
+  // large one is merged into the AVL tree and the small one inserted
+  for (const char* type : {AVL_MEMTABLE, SKIPLIST_MEMTABLE}) {
+    Memtable memtable(10000, 10, type);
+    for (int64_t key = 3; key <= 3000; key += 3) {
+      memtable.put(key, key);
+    }
+    vector<KeyValuePair> batch;
+    for (int64_t key = 2; key <= 3000; key += 2) {
+      batch.push_back({key, -key});
+    }
+    memtable.put_sorted(batch);
+    memtable.put_sorted({{1, 1}, {6000, 6000}});
+
+    if (memtable.get_size() != 2002) {
+      return false;
+    }
+    vector<KeyValuePair> values = memtable.scan(1, 6000);
+    for (size_t i = 0; i < values.size(); i++) {
+      int64_t key = values[i].key;
+      int64_t expected = key % 2 == 0 && key <= 3000 ? -key : key;
+      if (values[i].value != expected ||
+          (i > 0 && values[i - 1].key >= key)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 bool testCloseDatabase(Memtable& memtable) {
   // This test shold close the memtable and will do the same in the database
   memtable.close();
@@ -263,6 +400,42 @@ bool runMemtableTests() {
   }
   total_tests += 1;
 
+  cout << "Test merging iterator\n";
+  if (testMergingIterator()) {
+    cout << "testMergingIterator passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testMergingIterator failed\n";
+  }
+  total_tests += 1;
+
+  cout << "Test skiplist memtable\n";
+  if (testSkipListMemtable()) {
+    cout << "testSkipListMemtable passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testSkipListMemtable failed\n";
+  }
+  total_tests += 1;
+
+  cout << "Test concurrent puts into a skiplist memtable\n";
+  if (testSkipListConcurrentPuts()) {
+    cout << "testSkipListConcurrentPuts passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testSkipListConcurrentPuts failed\n";
+  }
+  total_tests += 1;
+
+  cout << "Test sorted batches of puts\n";
+  if (testPutSorted()) {
+    cout << "testPutSorted passed.\n";
+    test_pass_counter += 1;
+  } else {
+    cout << "testPutSorted failed\n";
+  }
+  total_tests += 1;
+
   cout << "Test close\n";
   if (testCloseDatabase(memtable2)) {
     cout << "testCloseDatabase passed.\n";